@@ -0,0 +1,55 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+
+// Reference results of benchmark.ino, the run fails if a benchmark is slower than
+// nsPerOp * (1 + BASELINE_TOLERANCE) or allocates more than allocsPerOp.
+// 0 and -1 mean "not recorded": run the sketch on your board and paste the lines it prints after "baseline:".
+// Results are only comparable on the same chip, clock and core version.
+//
+// Host results (host/Makefile) are kept separately. They were recorded with g++ -O2 on x86-64 Linux.
+// Allocation counts are exact and don't depend on the machine. Timings of shared machines vary a lot,
+// so the host tolerance is wider.
+
+struct Baseline {
+  const char* name;
+  uint32_t nsPerOp;
+  int32_t allocsPerOp;
+};
+
+#ifdef FTP32_HOST_BENCH
+
+#define BASELINE_TOLERANCE 0.5
+
+static const Baseline baselines[] = {
+  {"login_feat", 15914, 14},
+  {"reply", 1078, 1},
+  {"pasv_list", 6831, 9},
+  {"epsv_list", 6427, 8},
+  {"download_64k", 3039300, 9},
+  {"rmtree_mlsd_200", 1050200, 1423},
+  {"download_many_8", 16499900, 64},
+  {"download_loop_8", 16511200, 64},
+  {"upload_many_8", 17228000, 56},
+  {"upload_loop_8", 24063900, 56},
+};
+
+#else
+
+#define BASELINE_TOLERANCE 0.15
+
+static const Baseline baselines[] = {
+  {"login_feat", 0, -1},
+  {"reply", 0, -1},
+  {"pasv_list", 0, -1},
+  {"epsv_list", 0, -1},
+  {"download_64k", 0, -1},
+  {"rmtree_mlsd_200", 0, -1},
+  {"download_many_8", 0, -1},
+  {"download_loop_8", 0, -1},
+  {"upload_many_8", 0, -1},
+  {"upload_loop_8", 0, -1},
+};
+
+#endif
+
+#endif // BASELINE_H
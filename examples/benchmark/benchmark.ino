@@ -0,0 +1,280 @@
+// Microbenchmarks of the parsing and data path hot loops.
+// Server transcripts are replayed from memory, so neither WiFi nor a server is needed
+// and results depend only on the library code.
+// 
+// Allocation counts require heap tracing (CONFIG_HEAP_TRACING_STANDALONE, ESP-IDF 5+),
+// otherwise they're reported as -1 and not checked.
+// 
+// The same sketch builds on a PC against the shims in host/, @see host/Makefile
+
+#include <Arduino.h>
+#include <esp_idf_version.h>
+#include "ftp32.h"
+#include "memory_client.h"
+#include "baseline.h"
+
+#if defined(FTP32_HOST_BENCH)
+#define BENCH_COUNT_ALLOCS
+#elif defined(CONFIG_HEAP_TRACING_STANDALONE) && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <esp_heap_trace.h>
+#define BENCH_COUNT_ALLOCS
+static heap_trace_record_t traceRecords[64];
+#endif
+
+#define BENCH_REPEATS 5 ///< the fastest run counts, the rest is noise (interrupts, other tasks)
+
+MemoryClient ctrl(false);
+MemoryClient data(true);
+FTP32 ftp(ctrl, data);
+String sink;
+bool benchOk{true}; ///< result of the last setup()
+
+// ============ transcripts
+const char* featNoEpsv = 
+  "211-Features:\r\n"
+  " MDTM\r\n"
+  " MLST type*;size*;modify*;\r\n"
+  " SIZE\r\n"
+  " UTF8\r\n"
+  " REST STREAM\r\n"
+  "211 End\r\n";
+
+const char* featEpsv = 
+  "211-Features:\r\n"
+  " EPRT\r\n"
+  " EPSV\r\n"
+  " MDTM\r\n"
+  " MLST type*;size*;modify*;\r\n"
+  " SIZE\r\n"
+  " UTF8\r\n"
+  " REST STREAM\r\n"
+  "211 End\r\n";
+
+String login(const char* feat){
+  return String("220-Welcome to the benchmark FTP service.\r\n")
+    + "220-Files older than 30 days are removed.\r\n"
+    + "220 Ready.\r\n"
+    + "331 Please specify the password.\r\n"
+    + "230 Login successful.\r\n"
+    + feat;
+}
+
+uint16_t connect(const char* feat){
+  ctrl.setLatency(0);
+  ctrl.load(login(feat));
+  ctrl.stop();
+  return ftp.connectWithPassword("bench", "bench");
+}
+
+// batches of small files against a server one round trip away, per-file overhead is (ns/op) / BATCH_FILES
+#define BATCH_FILES 8
+#define BATCH_RTT_US 1000
+
+const char* batchPaths[BATCH_FILES] = {"/f0.txt", "/f1.txt", "/f2.txt", "/f3.txt", "/f4.txt", "/f5.txt", "/f6.txt", "/f7.txt"};
+String batchDests[BATCH_FILES];
+uint8_t batchPayload[1024];
+const uint8_t* batchData[BATCH_FILES];
+size_t batchSizes[BATCH_FILES];
+
+/** @param[in] perFile replies to a single file transfer @see MemoryClient::setLatency **/
+uint16_t prepareBatch(const char* perFile){
+  uint16_t res = connect(featEpsv);
+  String replies;
+  for( int i = 0; i < BATCH_FILES; ++i ){
+    replies += perFile;
+    batchData[i] = batchPayload;
+    batchSizes[i] = sizeof(batchPayload);
+  }
+  ctrl.load(replies);
+  ctrl.setLatency(BATCH_RTT_US);
+  data.linkReplies(ctrl);
+  String payload;
+  for( size_t i = 0; i < sizeof(batchPayload); ++i ){
+    batchPayload[i] = 'a' + i % 26;
+    payload += (char)batchPayload[i];
+  }
+  data.load(payload);
+  return res;
+}
+
+const char* batchDownload = 
+  "229 Entering Extended Passive Mode (|||50000|)\r\n"
+  "150 Opening BINARY mode data connection.\r\n"
+  "226 Transfer complete.\r\n";
+
+// 226 of an upload is sent only once the server sees the end of data
+const char* batchUpload = 
+  "229 Entering Extended Passive Mode (|||50000|)\r\n"
+  "150 Ok to send data.\r\n"
+  "\f226 Transfer complete.\r\n";
+
+// ============ benchmarks
+struct Bench {
+  const char* name;
+  uint32_t iterations;
+  uint16_t (*prepare)(); ///< loads transcripts, returns non-zero on failure
+  uint16_t (*op)();      ///< one iteration, returns non-zero on failure
+};
+
+const Bench benches[] = {
+  {"login_feat", 500,
+    [](){ ctrl.setLatency(0); ctrl.load(login(featEpsv)); return (uint16_t)0; },
+    [](){ ctrl.stop(); return ftp.connectWithPassword("bench", "bench"); }},
+
+  {"reply", 5000,
+    [](){ ctrl.load("215 UNIX Type: L8\r\n"); return (uint16_t)0; },
+    [](){ ctrl.rewind(); return ftp.getSystemInfo(sink); }},
+
+  {"pasv_list", 1000,
+    [](){ 
+      uint16_t res = connect(featNoEpsv);
+      ctrl.load("227 Entering Passive Mode (192,168,100,200,195,80).\r\n"
+                "150 Here comes the directory listing.\r\n"
+                "226 Directory send OK.\r\n");
+      data.load("");
+      return res;
+    },
+    [](){ ctrl.rewind(); sink = ""; return ftp.listContent("/", FTP32::ListType::SIMPLE, sink); }},
+
+  {"epsv_list", 1000,
+    [](){ 
+      uint16_t res = connect(featEpsv);
+      ctrl.load("229 Entering Extended Passive Mode (|||50000|)\r\n"
+                "150 Here comes the directory listing.\r\n"
+                "226 Directory send OK.\r\n");
+      data.load("");
+      return res;
+    },
+    [](){ ctrl.rewind(); sink = ""; return ftp.listContent("/", FTP32::ListType::SIMPLE, sink); }},
+
+  {"download_64k", 20,
+    [](){
+      uint16_t res = connect(featEpsv);
+      ctrl.load("229 Entering Extended Passive Mode (|||50000|)\r\n"
+                "150 Opening BINARY mode data connection for /frame.jpg (65536 bytes).\r\n"
+                "226 Transfer complete.\r\n");
+      String payload;
+      payload.reserve(65536);
+      for( int i = 0; i < 65536; ++i ){ payload += (char)('a' + i % 26); }
+      data.load(payload);
+      sink.reserve(65536);
+      return res;
+    },
+    [](){ ctrl.rewind(); sink = ""; return ftp.downloadSingleshot("/frame.jpg", sink); }},
+
+  {"rmtree_mlsd_200", 20,
+    [](){
+      uint16_t res = connect(featEpsv);
+      String replies = "229 Entering Extended Passive Mode (|||50000|)\r\n"
+                       "150 Here comes the directory listing.\r\n"
+                       "226 Directory send OK.\r\n";
+      String listing;
+      for( int i = 0; i < 200; ++i ){
+        replies += "250 Delete operation successful.\r\n";
+        listing += "type=file;size=48213;modify=20231015093000; frame_" + String(i) + ".jpg\r\n";
+      }
+      replies += "250 Remove directory operation successful.\r\n";
+      ctrl.load(replies);
+      data.load(listing);
+      return res;
+    },
+    [](){ ctrl.rewind(); return ftp.rmtree("/frames"); }},
+
+  {"download_many_8", 10,
+    [](){ return prepareBatch(batchDownload); },
+    [](){
+      ctrl.rewind();
+      for( auto& d : batchDests ){ d = ""; }
+      return ftp.downloadMany(batchPaths, batchDests, BATCH_FILES);
+    }},
+
+  {"download_loop_8", 10,
+    [](){ return prepareBatch(batchDownload); },
+    [](){
+      ctrl.rewind();
+      for( int i = 0; i < BATCH_FILES; ++i ){
+        batchDests[i] = "";
+        if( ftp.downloadSingleshot(batchPaths[i], batchDests[i]) ) return ftp.getLastCode();
+      }
+      return (uint16_t)0;
+    }},
+
+  {"upload_many_8", 10,
+    [](){ return prepareBatch(batchUpload); },
+    [](){ ctrl.rewind(); return ftp.uploadMany(batchPaths, batchData, batchSizes, BATCH_FILES, FTP32::CREATE_REPLACE); }},
+
+  {"upload_loop_8", 10,
+    [](){ return prepareBatch(batchUpload); },
+    [](){
+      ctrl.rewind();
+      for( int i = 0; i < BATCH_FILES; ++i ){
+        if( ftp.uploadSingleshot(batchPaths[i], batchPayload, sizeof(batchPayload), FTP32::CREATE_REPLACE) ) return ftp.getLastCode();
+      }
+      return (uint16_t)0;
+    }},
+};
+
+// ============ runner
+const Baseline* findBaseline(const char* name){
+  for( auto& b : baselines ){
+    if( !strcmp(b.name, name) ) return &b;
+  }
+  return nullptr;
+}
+
+/** @return false if the benchmark is slower or allocates more than its baseline **/
+bool run(const Bench& b){
+  if( b.prepare() || b.op() ){ // warm-up, also validates the transcript
+    Serial.printf("%-18s FAILED %d %s\n", b.name, ftp.getLastCode(), ftp.getLastMsg().c_str());
+    return false;
+  }
+
+  int32_t allocs{-1};
+#if defined(FTP32_HOST_BENCH)
+  size_t allocsBefore = hostAllocations();
+  b.op();
+  allocs = hostAllocations() - allocsBefore;
+#elif defined(BENCH_COUNT_ALLOCS)
+  heap_trace_init_standalone(traceRecords, sizeof(traceRecords) / sizeof(traceRecords[0]));
+  heap_trace_start(HEAP_TRACE_ALL);
+  b.op();
+  heap_trace_stop();
+  heap_trace_summary_t summary;
+  heap_trace_summary(&summary);
+  allocs = summary.total_allocations;
+#endif
+
+  size_t bytesPerOp = ctrl.size() + data.size();
+  int64_t duration{INT64_MAX};
+  for( int r = 0; r < BENCH_REPEATS; ++r ){
+    int64_t startTime = esp_timer_get_time();
+    for( uint32_t i = 0; i < b.iterations; ++i ){ b.op(); }
+    duration = min(duration, esp_timer_get_time() - startTime);
+  }
+
+  uint32_t nsPerOp = duration * 1000 / b.iterations;
+  double mbPerSec = (double)bytesPerOp * b.iterations / duration; // bytes/us == MB/s
+
+  bool ok{true};
+  const Baseline* base = findBaseline(b.name);
+  if( base && base->nsPerOp && nsPerOp > base->nsPerOp * (1 + BASELINE_TOLERANCE) ) ok = false;
+  if( base && base->allocsPerOp >= 0 && allocs > base->allocsPerOp ) ok = false;
+
+  Serial.printf("%-18s %12u %10.2f %10d %s\n", b.name, nsPerOp, mbPerSec, allocs, ok ? "ok" : "REGRESSION");
+  Serial.printf("baseline:  {\"%s\", %u, %d},\n", b.name, nsPerOp, allocs);
+  return ok;
+}
+
+void setup(){
+  Serial.begin(115200);
+  delay(1000);
+
+  Serial.printf("%-18s %12s %10s %10s\n", "benchmark", "ns/op", "MB/s", "allocs/op");
+  benchOk = true;
+  for( auto& b : benches ){
+    benchOk &= run(b);
+  }
+  Serial.println(benchOk ? "BENCH OK" : "BENCH FAIL");
+}
+
+void loop(){}
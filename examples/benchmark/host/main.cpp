@@ -0,0 +1,25 @@
+// Runs benchmark.ino on a PC, exit code is non-zero on regression @see Makefile
+
+#include <new>
+#include "Arduino.h"
+#include "../benchmark.ino"
+
+static size_t allocations{};
+
+size_t hostAllocations(){
+  return allocations;
+}
+
+void* operator new(size_t size){
+  allocations++;
+  if( void* p = malloc(size ? size : 1) ) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+int main(){
+  setup();
+  return benchOk ? 0 : 1;
+}
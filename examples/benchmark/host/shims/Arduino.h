@@ -0,0 +1,127 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Just enough of the Arduino core to build FTP32 and benchmark.ino on a PC @see ../Makefile
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cctype>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+/** @return calls of operator new so far, counted by main.cpp **/
+size_t hostAllocations();
+
+class String {
+public:
+  String(){}
+  String(const char* s) : _s(s ? s : ""){}
+  String(char c) : _s(1, c){}
+  String(int v) : _s(std::to_string(v)){}
+  String(unsigned v) : _s(std::to_string(v)){}
+  String(long v) : _s(std::to_string(v)){}
+  String(unsigned long v) : _s(std::to_string(v)){}
+
+  const char* c_str() const { return _s.c_str(); }
+  unsigned length() const { return _s.length(); }
+  bool isEmpty() const { return _s.empty(); }
+  void reserve(unsigned size){ _s.reserve(size); }
+
+  String& operator+=(const String& s){ _s += s._s; return *this; }
+  String& operator+=(const char* s){ _s += s; return *this; }
+  String& operator+=(char c){ _s += c; return *this; }
+  friend String operator+(String a, const String& b){ return a += b; }
+  friend String operator+(String a, const char* b){ return a += b; }
+  friend String operator+(String a, char b){ return a += b; }
+  friend String operator+(const char* a, const String& b){ return String(a) += b; }
+
+  bool operator==(const String& s) const { return _s == s._s; }
+  bool operator==(const char* s) const { return _s == s; }
+  bool operator!=(const String& s) const { return _s != s._s; }
+  bool operator!=(const char* s) const { return _s != s; }
+  char operator[](unsigned i) const { return i < _s.length() ? _s[i] : 0; }
+  char& operator[](unsigned i){ return _s[i]; }
+
+  int indexOf(char c, unsigned from = 0) const { return _pos(_s.find(c, from)); }
+  int indexOf(const char* s, unsigned from = 0) const { return _pos(_s.find(s, from)); }
+  int indexOf(const String& s, unsigned from = 0) const { return indexOf(s.c_str(), from); }
+  int lastIndexOf(char c) const { return _pos(_s.rfind(c)); }
+  bool startsWith(const String& s) const { return _s.compare(0, s._s.length(), s._s) == 0; }
+
+  String substring(unsigned left, unsigned right) const {
+    if( right > _s.length() ) right = _s.length();
+    if( left >= right ) return String();
+    return String(_s.substr(left, right - left));
+  }
+  String substring(unsigned left) const { return substring(left, _s.length()); }
+
+  void trim(){
+    size_t left = _s.find_first_not_of(" \t\r\n");
+    size_t right = _s.find_last_not_of(" \t\r\n");
+    _s = left == std::string::npos ? "" : _s.substr(left, right - left + 1);
+  }
+  void toUpperCase(){ for( auto& c : _s ) c = toupper(c); }
+
+private:
+  String(std::string s) : _s(std::move(s)){}
+  static int _pos(size_t p){ return p == std::string::npos ? -1 : p; }
+
+  std::string _s;
+};
+
+class Print {
+public:
+  virtual ~Print(){}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t size) = 0;
+  virtual void flush(){}
+
+  size_t print(const String& s){ return write((const uint8_t*)s.c_str(), s.length()); }
+  size_t print(const char* s){ return write((const uint8_t*)s, strlen(s)); }
+  size_t println(const char* s = ""){ return print(s) + print("\n"); }
+  size_t println(const String& s){ return println(s.c_str()); }
+  size_t printf(const char* format, ...){
+    char buff[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buff, sizeof(buff), format, args);
+    va_end(args);
+    return write((const uint8_t*)buff, min(n, (int)sizeof(buff) - 1));
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+class IPAddress {
+public:
+  IPAddress(){}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _addr{a, b, c, d}{}
+  bool fromString(const char* s){ return sscanf(s, "%hhu.%hhu.%hhu.%hhu", _addr, _addr + 1, _addr + 2, _addr + 3) == 4; }
+
+private:
+  uint8_t _addr[4]{};
+};
+
+class HostSerial : public Print {
+public:
+  void begin(unsigned long){}
+  size_t write(uint8_t c){ return fwrite(&c, 1, 1, stdout); }
+  size_t write(const uint8_t* buf, size_t size){ return fwrite(buf, 1, size, stdout); }
+};
+
+inline HostSerial Serial;
+
+inline void delay(unsigned long){}
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,26 @@
+#ifndef HOST_WIFICLIENT_H
+#define HOST_WIFICLIENT_H
+
+#include "Client.h"
+
+/** @brief never connects, the benchmark only uses in-memory transports **/
+class WiFiClient : public Client {
+public:
+  int connect(IPAddress ip, uint16_t port){ return 0; }
+  int connect(const char* host, uint16_t port){ return 0; }
+  int connect(IPAddress ip, uint16_t port, int32_t timeout){ return 0; }
+  int connect(const char* host, uint16_t port, int32_t timeout){ return 0; }
+  size_t write(uint8_t c){ return 0; }
+  size_t write(const uint8_t* buf, size_t size){ return 0; }
+  int available(){ return 0; }
+  int read(){ return -1; }
+  int read(uint8_t* buf, size_t size){ return -1; }
+  int peek(){ return -1; }
+  void flush(){}
+  void stop(){}
+  uint8_t connected(){ return 0; }
+  operator bool(){ return false; }
+  IPAddress remoteIP(){ return IPAddress(); }
+};
+
+#endif // HOST_WIFICLIENT_H
@@ -0,0 +1,22 @@
+#ifndef HOST_MINIZ_H
+#define HOST_MINIZ_H
+
+// MODE Z isn't benchmarked, every call fails
+
+#include <cstddef>
+#include <cstdint>
+
+typedef struct { int m_state; } tdefl_compressor;
+typedef struct { int m_state; } tinfl_decompressor;
+typedef enum { TDEFL_NO_FLUSH = 0, TDEFL_FINISH = 4 } tdefl_flush;
+typedef enum { TDEFL_STATUS_BAD_PARAM = -2, TDEFL_STATUS_OKAY = 0, TDEFL_STATUS_DONE = 1 } tdefl_status;
+typedef enum { TINFL_STATUS_FAILED = -1, TINFL_STATUS_DONE = 0, TINFL_STATUS_NEEDS_MORE_INPUT = 1 } tinfl_status;
+enum { TDEFL_WRITE_ZLIB_HEADER = 0x1000, TINFL_FLAG_PARSE_ZLIB_HEADER = 1, TINFL_FLAG_HAS_MORE_INPUT = 2, TINFL_LZ_DICT_SIZE = 32768 };
+
+#define tinfl_init(r) do { (r)->m_state = 0; } while(0)
+
+inline tdefl_status tdefl_init(tdefl_compressor*, void*, void*, int){ return TDEFL_STATUS_BAD_PARAM; }
+inline tdefl_status tdefl_compress(tdefl_compressor*, const void*, size_t*, void*, size_t*, tdefl_flush){ return TDEFL_STATUS_BAD_PARAM; }
+inline tinfl_status tinfl_decompress(tinfl_decompressor*, const uint8_t*, size_t*, uint8_t*, uint8_t*, size_t*, uint32_t){ return TINFL_STATUS_FAILED; }
+
+#endif // HOST_MINIZ_H
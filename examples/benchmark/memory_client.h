@@ -0,0 +1,136 @@
+#ifndef MEMORY_CLIENT_H
+#define MEMORY_CLIENT_H
+
+#include <Client.h>
+#include <esp_timer.h>
+
+/** @brief Client that serves a fixed buffer instead of a connection, writes are discarded.
+  * connect() rewinds the buffer, so one transcript serves every iteration of a benchmark.
+  *
+  * With latency set, the buffer is treated as a sequence of server replies: each write (a command)
+  * releases the replies up to the next final (2xx-5xx) one after the latency, like a server one round trip away.
+  * Pipelined commands overlap their latencies the same way they would on a real connection.
+  * A '\f' in the transcript ends the group early, the rest is released once the linked data client is stopped,
+  * e.g. "150 ...\r\n\f226 ...\r\n" for an upload, where 226 comes only after the server sees the data end.
+  **/
+class MemoryClient : public Client {
+public:
+  /** @param[in] closeWhenDrained report disconnect once everything's read (like a data channel after the transfer) **/
+  MemoryClient(bool closeWhenDrained) : _close_when_drained(closeWhenDrained){}
+
+  void load(const String& content){
+    _break_count = 0;
+    if( content.indexOf('\f') == -1 ){
+      _data = content;
+    } else {
+      _data = "";
+      for( size_t i = 0; i < content.length(); ++i ){
+        if( content[i] != '\f' ){ _data += content[i]; continue; }
+        if( _break_count < sizeof(_breaks) / sizeof(_breaks[0]) ) _breaks[_break_count++] = _data.length();
+      }
+    }
+    _pos = _data.length();
+    _visible = _scheduled = _data.length();
+    _pending_count = 0;
+  }
+
+  /** @param[in] us round trip time of each command, 0 makes the whole buffer available at once **/
+  void setLatency(uint32_t us){
+    _latency_us = us;
+  }
+
+  /** @brief stop() of this client releases the next group of replies of the control one @see setLatency() **/
+  void linkReplies(MemoryClient& control){
+    _linked = &control;
+  }
+
+  void rewind(){
+    _pos = 0;
+    _open = true;
+    _visible = _scheduled = _latency_us ? 0 : _data.length();
+    _pending_count = 0;
+  }
+
+  size_t size(){ return _data.length(); }
+
+  // Client
+  int connect(IPAddress ip, uint16_t port){ rewind(); return 1; }
+  int connect(const char* host, uint16_t port){ rewind(); return 1; }
+  size_t write(uint8_t c){ return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size){
+    if( !_open ) return 0;
+    if( _latency_us ) _release();
+    return size;
+  }
+  int available(){
+    if( !_open ) return 0;
+    if( _pending_count ){
+      int64_t now = esp_timer_get_time();
+      while( _pending_count && _pending[0].at <= now ){
+        _visible = _pending[0].end;
+        memmove(_pending, _pending + 1, --_pending_count * sizeof(Release));
+      }
+    }
+    return _visible - _pos;
+  }
+  int read(){ return available() ? _data[_pos++] : -1; }
+  int read(uint8_t* buf, size_t size){
+    size_t n = min(size, (size_t)available());
+    memcpy(buf, _data.c_str() + _pos, n);
+    _pos += n;
+    return n;
+  }
+  int peek(){ return available() ? _data[_pos] : -1; }
+  void flush(){}
+  void stop(){
+    // only a group held back by '\f' waits for the data end, others wait for their commands
+    if( _open && _linked && _linked->_latency_us && _linked->_isBreak(_linked->_scheduled) ) _linked->_release();
+    _open = false;
+  }
+  uint8_t connected(){ return _open && (!_close_when_drained || available()); }
+  operator bool(){ return connected(); }
+
+private:
+  struct Release {
+    size_t end;
+    int64_t at;
+  };
+
+  /** @brief schedules the replies up to the next final one **/
+  void _release(){
+    size_t end = _scheduled;
+    while( end < _data.length() ){
+      int lineEnd = _data.indexOf('\n', end);
+      size_t next = lineEnd == -1 ? _data.length() : lineEnd + 1;
+      bool final = next - end > 4 && isdigit(_data[end]) && _data[end + 3] == ' ' && _data[end] != '1';
+      end = next;
+      if( final || _isBreak(end) ) break;
+    }
+    if( end == _scheduled || _pending_count == sizeof(_pending) / sizeof(_pending[0]) ) return;
+    _pending[_pending_count++] = Release{end, esp_timer_get_time() + _latency_us};
+    _scheduled = end;
+  }
+
+  bool _isBreak(size_t pos){
+    for( uint8_t i = 0; i < _break_count; ++i ){
+      if( _breaks[i] == pos ) return true;
+    }
+    return false;
+  }
+
+  String _data;
+  size_t _pos{};
+  bool _open{false};
+  bool _close_when_drained;
+
+  uint32_t _latency_us{};
+  size_t _visible{};   ///< bytes released so far
+  size_t _scheduled{}; ///< bytes released or waiting for their time
+  Release _pending[4];
+  uint8_t _pending_count{};
+  size_t _breaks[16];
+  uint8_t _break_count{};
+  MemoryClient* _linked{nullptr};
+};
+
+#endif // MEMORY_CLIENT_H
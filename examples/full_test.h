@@ -3,6 +3,8 @@
 
 #define FTP32_LOG FTP32_LOG_INFO
 #include "ftp32.h"
+#include "ftp32_replay.h"
+#include <StreamString.h>
 
 // you can this function to check 
 // that all methods work correctly for your server
@@ -21,6 +23,9 @@ void test_all(const char* ip, uint8_t port, const char* username, const char* pa
     // sometime this thing prints an error (probably WiFiClient implemantation related)
     ftp.disconnect(); 
     ftp.connectWithPassword(username, password);
+    if( !ftp.hasFeature(FTP32::Feature::SIZE) || !ftp.hasFeature(FTP32::Feature::MLST) ){
+        Serial.printf("Features 0x%x, SIZE and MLST are expected\n", ftp.getFeatures());
+    }
 
     // UPLOAD
     String data_p1 = "some";
@@ -35,6 +40,21 @@ void test_all(const char* ip, uint8_t port, const char* username, const char* pa
 
     ftp.uploadSingleshot("/upload.single", String(data_p1 + data_p2 + data_p3).c_str(), FTP32::CREATE_REPLACE);
 
+    const char* many_paths[] = {"/upload.many1", "/upload.many2"};
+    const uint8_t* many_data[] = {(const uint8_t*)data_p1.c_str(), (const uint8_t*)data_p3.c_str()};
+    size_t many_sizes[] = {data_p1.length(), data_p3.length()};
+    ftp.uploadMany(many_paths, many_data, many_sizes, 2, FTP32::CREATE_REPLACE);
+
+    FTP32SegmentWriter<64, 2> segments(ftp, "/segment_", ".bin", 100);
+    segments.begin();
+    for( int i = 0; i < 30; ++i ){ segments.write((const uint8_t*)data_p3.c_str(), data_p3.length()); }
+    segments.end();
+    if( segments.getStats().published != 2 || segments.getStats().bytes != 30 * data_p3.length() ){
+        Serial.printf("Segments published %d (%d bytes)\n", segments.getStats().published, (int)segments.getStats().bytes);
+    }
+    ftp.deleteFile("/segment_0.bin");
+    ftp.deleteFile("/segment_1.bin");
+
     // FILE UTILS
     ftp.renameFile("/upload.single", "/upload_single.renamed");
     ftp.deleteFile("/upload_single.renamed");
@@ -49,6 +69,14 @@ void test_all(const char* ip, uint8_t port, const char* username, const char* pa
         Serial.printf("Up|Down differs %s | %s\n", (data_p1 + data_p2 + data_p3).c_str(), content.c_str()); 
     }
 
+    String many_content[2];
+    ftp.downloadMany(many_paths, many_content, 2);
+    if( many_content[0] != data_p1 || many_content[1] != data_p3 ){
+        Serial.printf("Batch up|down differs %s%s | %s%s\n", data_p1.c_str(), data_p3.c_str(), many_content[0].c_str(), many_content[1].c_str());
+    }
+    ftp.deleteFile(many_paths[0]);
+    ftp.deleteFile(many_paths[1]);
+
     size_t read{};
     char raw_content[fsize];
     char* p = raw_content;
@@ -68,6 +96,99 @@ void test_all(const char* ip, uint8_t port, const char* username, const char* pa
     ftp.listContent("/", FTP32::ListType::SIMPLE, content);
     ftp.setTransferType(FTP32::TransferType::ASCII);
     ftp.setTransferType(FTP32::TransferType::BINARY);
+    if( !ftp.setTransferMode(FTP32::TransferMode::DEFLATE) ){
+        ftp.uploadSingleshot("/upload.deflate", String(data_p1 + data_p2 + data_p3).c_str(), FTP32::CREATE_REPLACE);
+        content = "";
+        ftp.downloadSingleshot("/upload.deflate", content);
+        if( content != (data_p1 + data_p2 + data_p3) ){
+            Serial.printf("Deflate up|down differs %s | %s\n", (data_p1 + data_p2 + data_p3).c_str(), content.c_str());
+        }
+        ftp.setTransferMode(FTP32::TransferMode::STREAM);
+        ftp.deleteFile("/upload.deflate");
+    }
     ftp.getLastModificationDate("/upload.multi", content);
     ftp.getSystemInfo(content);
+    ftp.disconnect();
+
+    // FXP, same server as both ends (it must allow foreign PORT addresses)
+    FTP32 src(ip, port);
+    FTP32 dst(ip, port);
+    if( !src.connectWithPassword(username, password) && !dst.connectWithPassword(username, password) ){
+        ftp.connectWithPassword(username, password);
+        ftp.uploadSingleshot("/upload.fxp", String(data_p1 + data_p2 + data_p3).c_str(), FTP32::CREATE_REPLACE);
+        FTP32::fxp(src, "/upload.fxp", dst, "/upload.fxp.copy", 10000);
+        content = "";
+        ftp.downloadSingleshot("/upload.fxp.copy", content);
+        if( content != (data_p1 + data_p2 + data_p3) ){
+            Serial.printf("FXP copy differs %s | %s\n", (data_p1 + data_p2 + data_p3).c_str(), content.c_str());
+        }
+        ftp.deleteFile("/upload.fxp");
+        ftp.deleteFile("/upload.fxp.copy");
+        ftp.disconnect();
+    }
+    src.disconnect();
+    dst.disconnect();
+
+    // HOT STANDBY
+    FTP32 first(ip, port), second(ip, port);
+    first.setControlChannelTimeout(10000);
+    second.setControlChannelTimeout(10000);
+    FTP32HotStandby standby(first, second, username, password, 1000, true);
+    standby.begin();
+    delay(1500);
+    standby.poll(); // refreshes the standby, reopens its data channel
+    if( standby.uploadUrgent("/upload.urgent", (const uint8_t*)data_p3.c_str(), data_p3.length()) ){
+        Serial.printf("Urgent upload failed %d %s\n", standby.active().getLastCode(), standby.active().getLastMsg().c_str());
+    }
+    standby.poll();
+    standby.active().deleteFile("/upload.urgent");
+    if( standby.getStats().promotions != 1 ){
+        Serial.printf("Standby wasn't promoted, ttfb %dus\n", (int)standby.getStats().lastTtfbUs);
+    }
+    standby.active().disconnect();
+
+    // RECORD | REPLAY
+    StreamString trace;
+    String recorded;
+    {
+        WiFiClient c, d;
+        FTP32Recorder rec(trace);
+        FTP32RecordingClient rc(c, rec, 'C'), rd(d, rec, 'D');
+        FTP32 recording(rc, rd, ip, port);
+        recording.connectWithPassword(username, password);
+        recording.listContent("/", FTP32::ListType::MACHINE, recorded);
+        recording.disconnect();
+    }
+    {
+        String replayed;
+        FTP32Replay replay(trace);
+        {
+            FTP32 replaying(replay.control(), replay.data(), ip, port);
+            replaying.connectWithPassword(username, password);
+            replaying.listContent("/", FTP32::ListType::MACHINE, replayed);
+            replaying.disconnect();
+        } // whatever the destructor does is consumed too
+        if( replayed != recorded || !replay.finished() ){
+            Serial.printf("Replay differs %s | %s\n", recorded.c_str(), replayed.c_str());
+        }
+    }
+
+    // FTPS, the test server has a self-signed certificate, so verification is explicitly disabled
+    FTP32 ftps(ip, port);
+    ftps.useTls(nullptr, true);
+    if( !ftps.connectWithPassword(username, password) ){
+        ftps.uploadSingleshot("/upload.tls", String(data_p1 + data_p2 + data_p3).c_str(), FTP32::CREATE_REPLACE);
+        content = "";
+        ftps.downloadSingleshot("/upload.tls", content);
+        if( content != (data_p1 + data_p2 + data_p3) ){
+            Serial.printf("TLS up|down differs %s | %s\n", (data_p1 + data_p2 + data_p3).c_str(), content.c_str());
+        }
+        ftps.deleteFile("/upload.tls");
+        FTP32::TlsStats tls = ftps.getTlsStats();
+        if( tls.dataHandshakes != 2 || tls.lastDataHandshakeUs >= tls.controlHandshakeUs ){
+            Serial.printf("TLS handshakes: control %dus, %d data avg %dus (resumption expected)\n", 
+                (int)tls.controlHandshakeUs, tls.dataHandshakes, tls.dataHandshakes ? (int)(tls.totalDataHandshakeUs / tls.dataHandshakes) : 0);
+        }
+        ftps.disconnect();
+    }
 }
\ No newline at end of file
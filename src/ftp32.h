@@ -21,14 +21,222 @@
 
 
 #include <WiFiClient.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
 #include <stack>
+#include <utility>
 #include <esp_timer.h>
+#if __has_include(<miniz.h>)
+#include <miniz.h>
+#else
+#include <esp32/rom/miniz.h>
+#endif
 
 /** @name Abbreviations
   * - CWD Current Working Dir
   * - DOSI Depends On Server Implementation
   **/
 
+template<size_t ChunkSize, uint8_t ChunkCount> class FTP32SegmentWriter;
+
+/** @brief TLS layer on top of another client, used for explicit FTPS.
+  * Unlike WiFiClientSecure it's started on a connection that's already in use (after AUTH TLS)
+  * and can resume the session of another connection, which is what FTPS data channels need.
+  * 
+  * Record buffers (~32KiB) are allocated on the first handshake and kept until destruction.
+  **/
+class FTP32TlsClient : public Client {
+public:
+  FTP32TlsClient(Client& transport) : _transport(&transport){
+    mbedtls_ssl_init(&_ssl);
+    mbedtls_ssl_config_init(&_conf);
+    mbedtls_x509_crt_init(&_ca);
+    mbedtls_entropy_init(&_entropy);
+    mbedtls_ctr_drbg_init(&_drbg);
+  }
+
+  FTP32TlsClient(const FTP32TlsClient&) = delete;
+
+  ~FTP32TlsClient(){
+    stop();
+    mbedtls_ssl_free(&_ssl);
+    mbedtls_ssl_config_free(&_conf);
+    mbedtls_x509_crt_free(&_ca);
+    mbedtls_ctr_drbg_free(&_drbg);
+    mbedtls_entropy_free(&_entropy);
+  }
+
+  /** @brief replaces the underlying client, only while there's no TLS session on it **/
+  void setTransport(Client& transport){
+    _transport = &transport;
+  }
+
+  /** @brief sets CA certificate (PEM) the server is verified against. Applied on the first handshake.
+    * Either this or setInsecure() is required, handshake fails otherwise.
+    **/
+  void setCACert(const char* pem){
+    _ca_pem = pem;
+  }
+
+  /** @brief skips server verification when there's no CA certificate (self-signed test servers) **/
+  void setInsecure(){
+    _insecure = true;
+  }
+
+  /** @brief performs the handshake over the (connected) transport
+    * 
+    * @param[in] host server name for SNI and certificate verification
+    * @param[in] resume session to resume instead of a full handshake, may be nullptr
+    * @param[in] timeoutUs handshake timeout
+    * 
+    * @return 0 on success, mbedtls error otherwise
+    **/
+  int handshake(const char* host, const mbedtls_ssl_session* resume, int64_t timeoutUs){
+    int ret{};
+    if( !_configured && (ret = _configure()) ) return ret;
+
+    mbedtls_ssl_session_reset(&_ssl);
+    if( resume ) mbedtls_ssl_set_session(&_ssl, resume);
+    mbedtls_ssl_set_hostname(&_ssl, host);
+
+    int64_t startTime = esp_timer_get_time();
+    while( (ret = mbedtls_ssl_handshake(&_ssl)) ){
+      if( ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE ) return ret;
+      if( (esp_timer_get_time() - startTime) >= timeoutUs ) return MBEDTLS_ERR_SSL_TIMEOUT;
+    }
+    _active = true;
+    _has_peek = false;
+    return 0;
+  }
+
+  /** @brief copies the established session so another connection can resume it
+    * @return 0 on success, mbedtls error otherwise
+    **/
+  int getSession(mbedtls_ssl_session* dest){
+    return mbedtls_ssl_get_session(&_ssl, dest);
+  }
+
+  // Client
+  int connect(IPAddress ip, uint16_t port){ return _transport->connect(ip, port); }
+  int connect(const char* host, uint16_t port){ return _transport->connect(host, port); }
+
+  size_t write(uint8_t c){ return write(&c, 1); }
+
+  size_t write(const uint8_t* buf, size_t size){
+    if( !_active ) return 0;
+    size_t done{};
+    while( done < size ){
+      int ret = mbedtls_ssl_write(&_ssl, buf + done, size - done);
+      if( ret > 0 ) done += ret;
+      else if( ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE ) break;
+    }
+    return done;
+  }
+
+  int available(){
+    if( !_active ) return 0;
+    // decrypt the next record if there's nothing decrypted yet
+    if( !_has_peek && !mbedtls_ssl_get_bytes_avail(&_ssl) && _transport->available() ){
+      if( mbedtls_ssl_read(&_ssl, &_peek, 1) == 1 ) _has_peek = true;
+    }
+    return _has_peek + mbedtls_ssl_get_bytes_avail(&_ssl);
+  }
+
+  int read(){
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  int read(uint8_t* buf, size_t size){
+    if( !size || !available() ) return -1;
+    size_t done{};
+    if( _has_peek ){ buf[done++] = _peek; _has_peek = false; }
+    size_t avail = mbedtls_ssl_get_bytes_avail(&_ssl);
+    if( done < size && avail ){
+      int ret = mbedtls_ssl_read(&_ssl, buf + done, min(size - done, avail));
+      if( ret > 0 ) done += ret;
+    }
+    return done;
+  }
+
+  int peek(){
+    if( !available() ) return -1;
+    if( !_has_peek && mbedtls_ssl_read(&_ssl, &_peek, 1) == 1 ) _has_peek = true;
+    return _has_peek ? _peek : -1;
+  }
+
+  void flush(){}
+
+  void stop(){
+    if( _active ){
+      mbedtls_ssl_close_notify(&_ssl);
+      _active = false;
+    }
+    _has_peek = false;
+    _transport->stop();
+  }
+
+  uint8_t connected(){
+    return _active && (_has_peek || mbedtls_ssl_get_bytes_avail(&_ssl) || _transport->available() || _transport->connected());
+  }
+
+  operator bool(){ return connected(); }
+
+private:
+  int _configure(){
+    int ret{};
+    if( (ret = mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy, (const unsigned char*)"ftp32", 5))
+      || (ret = mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT)) ) return ret;
+
+    if( _ca_pem ){
+      if( (ret = mbedtls_x509_crt_parse(&_ca, (const unsigned char*)_ca_pem, strlen(_ca_pem) + 1)) ) return ret;
+      mbedtls_ssl_conf_ca_chain(&_conf, &_ca, nullptr);
+      mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    } else if( _insecure ){
+      mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
+    } else {
+      return MBEDTLS_ERR_SSL_BAD_INPUT_DATA; // neither CA nor explicit opt-out
+    }
+    mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+
+    if( (ret = mbedtls_ssl_setup(&_ssl, &_conf)) ) return ret;
+    mbedtls_ssl_set_bio(&_ssl, this, _send, _recv, nullptr);
+    _configured = true;
+    return 0;
+  }
+
+  static int _send(void* ctx, const unsigned char* buf, size_t len){
+    size_t written = static_cast<FTP32TlsClient*>(ctx)->_transport->write(buf, len);
+    return written ? written : MBEDTLS_ERR_NET_CONN_RESET;
+  }
+
+  static int _recv(void* ctx, unsigned char* buf, size_t len){
+    Client& t = *static_cast<FTP32TlsClient*>(ctx)->_transport;
+    if( !t.available() ) return t.connected() ? MBEDTLS_ERR_SSL_WANT_READ : 0; // 0 is EOF
+    int read = t.read(buf, len);
+    return read > 0 ? read : MBEDTLS_ERR_SSL_WANT_READ;
+  }
+
+private:
+  Client* _transport;
+  const char* _ca_pem{nullptr};
+  bool _insecure{false};
+  bool _configured{false};
+  bool _active{false};
+
+  uint8_t _peek;
+  bool _has_peek{false};
+
+  mbedtls_ssl_context _ssl;
+  mbedtls_ssl_config _conf;
+  mbedtls_x509_crt _ca;
+  mbedtls_entropy_context _entropy;
+  mbedtls_ctr_drbg_context _drbg;
+};
+
 /** @name CommonReturnValues
   * @brief Most methods return the values from below if not stated otherwise.
   * 
@@ -40,6 +248,12 @@
 class FTP32{
 public:
   enum TransferType {BINARY, ASCII};
+
+  /** @enum TransferMode
+    * - STREAM: data is sent as is (MODE S)
+    * - DEFLATE: data is zlib-compressed on the wire (MODE Z), worth it for text, not for JPEGs
+    **/
+  enum TransferMode {STREAM, DEFLATE};
   enum OpenType {CREATE_REPLACE, APPEND};
 
   /** @enum ListType
@@ -55,13 +269,53 @@ public:
       SIMPLE    ///< Simplified directory listing.
   };
 
+  /** @enum Feature
+    * Optional server capabilities, as listed in FEAT reply.
+    * Used as bit flags @see getFeatures()
+    **/
+  enum Feature : uint16_t {
+    MLST = 1 << 0,   ///< MLST and MLSD
+    SIZE = 1 << 1,
+    REST = 1 << 2,   ///< REST STREAM
+    EPSV = 1 << 3,
+    UTF8 = 1 << 4,
+    HASH = 1 << 5,
+    MODE_Z = 1 << 6,
+    MDTM = 1 << 7
+  };
+
   /** @enum Error
     * Enumerates library-related errors.
     **/
   enum Error {
     TIMEOUT = 1,  ///< for control channel
     INVARG = 2,   ///< (currently) applied if wrong enum value is passed
-    BUSY = 3      ///< data transfer is underway / disconnect() on not connected client / connect() on connected client
+    BUSY = 3,     ///< data transfer is underway / disconnect() on not connected client / connect() on connected client
+    UNSUPPORTED = 4, ///< server doesn't advertise the required feature
+    NOMEM = 5     ///< buffers for the operation can't be allocated
+  };
+
+  static constexpr uint32_t FXP_NO_TIMEOUT = UINT32_MAX; ///< @see fxp()
+
+  /** @struct TransferStats
+    * Describes the last data transfer (file or listing).
+    * Compression ratio is wireBytes / payloadBytes.
+    **/
+  struct TransferStats {
+    size_t payloadBytes; ///< bytes as seen by the user
+    size_t wireBytes;    ///< bytes that went through the data channel
+    int64_t codecUs;     ///< time spent compressing/decompressing
+  };
+
+  /** @struct TlsStats
+    * Handshake timings of the FTPS session.
+    * Data channels resume the control channel session, so their handshakes should be much shorter.
+    **/
+  struct TlsStats {
+    int64_t controlHandshakeUs;
+    int64_t lastDataHandshakeUs;
+    int64_t totalDataHandshakeUs;
+    uint32_t dataHandshakes;
   };
 
   /** @enum Status
@@ -75,8 +329,33 @@ public:
 
   FTP32(const char* address, uint8_t port = 21) 
     : _address(address), _port(port), _ctrl_timeout_us(5e6), _data_timeout_us(_ctrl_timeout_us * 2){
+      mbedtls_ssl_session_init(&_tls_session);
+    }
+
+  /** @brief uses the given clients instead of own WiFiClients, e.g. in-memory ones for tests and benchmarks.
+    * 
+    * @param[in] control control channel transport, its connect() gets address and port
+    * @param[in] data data channel transport, its connect() gets the passive address
+    * @param[in] address server address, also used as data channel host for EPSV
+    * @param[in] port server port
+    * @note timeouts don't apply to connect() of custom transports
+    **/
+  FTP32(Client& control, Client& data, const char* address = "127.0.0.1", uint8_t port = 21)
+    : FTP32(address, port){
+      _cTransport = &control;
+      _dTransport = &data;
+      _ctrl = _cTransport;
+      _cTls.setTransport(control);
+      _dTls.setTransport(data);
     }
 
+  FTP32(const FTP32&) = delete;
+
+  ~FTP32(){
+    _freeCodec();
+    mbedtls_ssl_session_free(&_tls_session);
+  }
+
 
   // CONNECTION
   /** @brief connects to ftp server with username and password
@@ -87,17 +366,34 @@ public:
     * @see CommonReturnValues
     **/
   uint16_t connectWithPassword(const char* username, const char* password) {
-    if( _cClient.connected() ) return Error::BUSY;
+    if( _ctrl->connected() ) return Error::BUSY;
+    _ctrl->stop(); // leftovers of a dropped session
+    _ctrl = _cTransport;
+    _prot_p = false;
+    _dropPreopened();
     FTP32_INFO("connecting as %s", username);
-    if(!_cClient.connect(_address, _port, _ctrl_timeout_us/1e3) 
+    if(!_connectTransport(*_cTransport, _cClient, _address, _port) 
       || _readResponse() != 220
+      || (_tls && _startTls())
       || _sendCmd("USER", username, 331)
-      || _sendCmd("PASS", password, 230))
+      || _sendCmd("PASS", password, 230)
+      || (_tls && (_sendCmd("PBSZ 0", 200) || _sendCmd("PROT P", 200))))
     {
       FTP32_FATAL("connection failed %d %s", _r_code, _r_msg.c_str());
       return _r_code;   
     } else {
       FTP32_INFO("connected");
+      _typeKnown = false;
+      _cwd = "";
+      _mode = TransferMode::STREAM; // a new session starts in MODE S
+      _freeCodec();
+      _prot_p = _tls;
+      if( _discoverFeatures() == Error::TIMEOUT ){
+        // a late FEAT reply would be taken for the replies of the following commands
+        FTP32_FATAL("no reply to FEAT, dropping the session");
+        _dropSession();
+        return _r_code;
+      }
       return 0;
     }
   }
@@ -106,10 +402,14 @@ public:
     * @see CommonReturnValues
     **/
   uint16_t disconnect() {
-    if( !_cClient.connected() ) return Error::BUSY;
+    if( !_ctrl->connected() ) return Error::BUSY;
 
+    _dropPreopened();
     uint16_t res = _sendCmd("QUIT", 221);
-    _cClient.stop(); 
+    _ctrl->stop(); 
+    _ctrl = _cTransport;
+    _prot_p = false;
+    _forgetTlsSession();
     FTP32_INFO("disconnected");
 
     return res;
@@ -126,10 +426,7 @@ public:
     * @see CommonReturnValues
     **/
   uint16_t initUpload(const char* destinationFilepath, OpenType t){
-    if( _dClient.connected() || _status != IDLE ){ return Error::BUSY; }
-
-    FTP32_INFO("initiating upload of %s", destinationFilepath);
-    if( _openDataChn(_dClient) ){ return _r_code; }
+    if( (_data().connected() && !_data_ready) || _status != IDLE ){ return Error::BUSY; }
 
     String cmd;
     switch(t){
@@ -142,7 +439,9 @@ public:
       default:
         return Error::INVARG;
     }
-    if( !_sendCmd(cmd.c_str(), destinationFilepath, 150) ){
+
+    FTP32_INFO("initiating upload of %s", destinationFilepath);
+    if( !_startTransfer(cmd.c_str(), destinationFilepath) ){
       _status = UPLOADING;
       return 0;
     } else { 
@@ -160,7 +459,7 @@ public:
   size_t uploadData(const char* data){
     if( _status != Status::UPLOADING ) return 0;
 
-    auto written = _dClient.write(data);
+    auto written = _writeData((const uint8_t*)data, strlen(data));
     FTP32_INFO("%d written", written);
 
     return written;
@@ -175,10 +474,10 @@ public:
     * @note does nothing if called before commencing transmission
     * @overload uploadData(const char* data)
     **/
-  size_t uploadData(uint8_t* data, size_t size){
+  size_t uploadData(const uint8_t* data, size_t size){
     if( _status != Status::UPLOADING ) return 0;
 
-    auto written = _dClient.write(data, size);
+    auto written = _writeData(data, size);
     FTP32_INFO("%d written", written);
 
     return written;
@@ -192,8 +491,16 @@ public:
   uint16_t finishUpload(){
     if( _status != Status::UPLOADING ) return 0;
 
-    _dClient.stop();
     _status = Status::IDLE;
+    if( uint16_t res = _finishData() ){
+      // just closing the data channel would make the server take the truncated file as complete
+      FTP32_ERROR("upload can't be finished");
+      _abortTransfer();
+      _data().stop();
+      _r_code = res;
+      return _r_code;
+    }
+    _data().stop();
     FTP32_INFO("upload fiished");
 
     return _readResponse() == 226 ? 0 : _r_code;
@@ -235,6 +542,137 @@ public:
   }
 
 
+  /** @brief uploads several files back to back.
+    * PASV|EPSV for the next file is sent before 226 of the current one is read
+    * and the next STOR goes out together with the data connection,
+    * which saves a round trip per file compared to consecutive uploadSingleshot() calls
+    * (two round trips per file instead of three, see upload_many_8 in examples/benchmark).
+    * The data connection itself is made after 226, since servers reply to PASV|EPSV only once the transfer is over.
+    *
+    * @param destinationFilepaths[in] paths of the files on server
+    * @param data[in] content of each file
+    * @param sizes[in] size of each file
+    * @param count[in] number of files
+    * @param openType[in] transaction type, same for all files
+    *
+    * @note stops on the first failure; files uploaded before it stay on server
+    * @see CommonReturnValues
+    **/
+  uint16_t uploadMany(const char* const* destinationFilepaths, const uint8_t* const* data, const size_t* sizes, size_t count, OpenType t){
+    if( _status != Status::IDLE ) return Error::BUSY;
+
+    const char* cmd;
+    switch(t){
+      case OpenType::CREATE_REPLACE: cmd = "STOR"; break;
+      case OpenType::APPEND: cmd = "APPE"; break;
+      default: return Error::INVARG;
+    }
+
+    FTP32_INFO("uploading %d files", count);
+    if( count && _requestPassive() ) return _r_code;
+    for( size_t i = 0; i < count; ++i ){
+      // STOR goes out before the data connection is made, the server is already listening after PASV
+      if( _expectPassive(cmd, destinationFilepaths[i]) ) return _r_code;
+
+      if( _writeData(data[i], sizes[i]) != sizes[i] || _finishData() ){
+        // just closing the data channel would make the server take the truncated file as complete
+        FTP32_ERROR("upload of %s failed", destinationFilepaths[i]);
+        _abortTransfer();
+        _data().stop();
+        _r_code = Error::TIMEOUT;
+        return _r_code;
+      }
+      _data().stop();
+      FTP32_INFO("%d written to %s", sizes[i], destinationFilepaths[i]);
+
+      if( _finishPipelined(i + 1 < count) ) return _r_code;
+    }
+
+    return 0;
+  }
+
+  /** @brief copies a file between two servers directly (FXP), the payload doesn't go through the device.
+    * 
+    * Source server is put into passive mode and the destination one is pointed at it with PORT, 
+    * then both control channels are watched until each server reports the end of the transfer.
+    * 
+    * @param src[in] session holding the file
+    * @param sourcePath[in] file to copy
+    * @param dst[in] session to copy the file to
+    * @param destinationFilepath[in] path to the file that will be created|overwritten on the destination server
+    * @param timeoutMs[in] limit for the whole transfer; 0 means the longer data channel timeout of the two sessions,
+    * FXP_NO_TIMEOUT means waiting for the servers as long as they're connected
+    * 
+    * @note both servers must allow connections from/to a foreign address (e.g. vsftpd pasv_promiscuous, port_promiscuous)
+    * @note not available with TLS, encrypted FXP needs SSCN/CPSV which are rarely supported
+    * @note both sessions must use the same transfer type and mode
+    * @return 0 on success, code of the session that failed otherwise @see CommonReturnValues
+    **/
+  static uint16_t fxp(FTP32& src, const char* sourcePath, FTP32& dst, const char* destinationFilepath, uint32_t timeoutMs = 0){
+    int64_t timeoutUs = timeoutMs == FXP_NO_TIMEOUT ? 0 
+      : timeoutMs ? timeoutMs * 1e3 : max(src._data_timeout_us, dst._data_timeout_us);
+    if( &src == &dst || src._status != IDLE || dst._status != IDLE ) return Error::BUSY;
+    if( src._prot_p || dst._prot_p ) return Error::UNSUPPORTED;
+    if( src._mode != dst._mode ) return Error::INVARG;
+
+    FTP32_INFO("fxp of %s to %s", sourcePath, destinationFilepath);
+    // PASV makes a pre-opened channel of src stale, PORT switches dst to active mode
+    src._dropPreopened();
+    dst._dropPreopened();
+    if( src._sendCmd("PASV", 227) ) return src._r_code;
+    int startPos = src._r_msg.indexOf("(");
+    int endPos = src._r_msg.indexOf(")");
+    if( startPos == -1 || endPos == -1 ){
+      FTP32_ERROR("malformed passive reply %s", src._r_msg.c_str());
+      return src._r_code;
+    }
+    // PASV and PORT share the h1,h2,h3,h4,p1,p2 format
+    if( dst._sendCmd("PORT", src._r_msg.substring(startPos + 1, endPos).c_str(), 200) ) return dst._r_code;
+
+    // destination connects on STOR, source starts sending on RETR
+    if( dst._writeCmd("STOR", destinationFilepath) ) return dst._r_code;
+    if( src._writeCmd("RETR", sourcePath) ){ dst._abortTransfer(); return src._r_code; }
+    uint16_t dstRes = dst._expect(150, "STOR", destinationFilepath);
+    uint16_t srcRes = src._expect(150, "RETR", sourcePath);
+    if( dstRes || srcRes ){
+      if( !dstRes ) dst._abortTransfer();
+      if( !srcRes ) src._abortTransfer();
+      return dstRes ? dstRes : srcRes;
+    }
+
+    FTP32* sessions[2] = {&src, &dst};
+    bool finished[2]{};
+    int64_t startTime = esp_timer_get_time();
+    while( !finished[0] || !finished[1] ){
+      for( int i = 0; i < 2; ++i ){
+        if( finished[i] ) continue;
+        FTP32& s = *sessions[i];
+        FTP32& other = *sessions[1 - i];
+        if( s._ctrl->available() ){
+          finished[i] = true;
+          if( s._expect(226, "transfer") ){
+            if( !finished[1 - i] ) other._abortTransfer();
+            return s._r_code;
+          }
+        } else if( !s._ctrl->connected() ){
+          FTP32_FATAL("control channel lost during fxp");
+          if( !finished[1 - i] ) other._abortTransfer();
+          s._r_code = Error::TIMEOUT;
+          return s._r_code;
+        }
+      }
+      if( timeoutUs && (esp_timer_get_time() - startTime) >= timeoutUs ){
+        FTP32_ERROR("fxp timed out");
+        if( !finished[0] ) src._abortTransfer();
+        if( !finished[1] ) dst._abortTransfer();
+        return Error::TIMEOUT;
+      }
+    }
+
+    FTP32_INFO("fxp finished");
+    return 0;
+  }
+
   // FILE UTILS
   /** @brief renames file
     * 
@@ -246,6 +684,7 @@ public:
   uint16_t renameFile(const char* from, const char* to){
     FTP32_INFO("renaming %s to %s", from, to);
     if( _sendCmd("RNFR", from, 350) || _sendCmd("RNTO", to, 250) ) return _r_code;
+    return 0;
   }
 
    /** @brief deletes file
@@ -267,6 +706,7 @@ public:
     * @see CommonReturnValues
     **/
   uint16_t fileSize(const char* filepath, size_t& dest){
+    if( _lacks(Feature::SIZE) ) return Error::UNSUPPORTED;
     FTP32_INFO("getting size of %s", filepath);
     if( _sendCmd("SIZE", filepath, 213) ) return _r_code;
     dest = strtoul(_r_msg.c_str(), nullptr, 0);
@@ -284,7 +724,7 @@ public:
     if( _status != Status::IDLE ) return Error::BUSY;
     FTP32_INFO("initiating download of %s", filename);
 
-    if( _openDataChn(_dClient) || _sendCmd("RETR", filename, 150) ){
+    if( _startTransfer("RETR", filename) ){
       return _r_code;
     } else {
       _status = Status::DOWNLOADING;
@@ -301,10 +741,11 @@ public:
     **/
   size_t downloadData(char* dest, size_t amount = 0){
     if( _status != Status::DOWNLOADING ) return 0;
-    size_t read = _readData(_dClient, dest, amount);
+    size_t read = _readData(_data(), dest, amount);
     FTP32_INFO("%d downloaded", read);
     if( !amount || (amount && read == 0) ){
       FTP32_INFO("download is finished");
+      _data().stop();
       _readResponse(); 
       _status = Status::IDLE; 
     };
@@ -322,9 +763,10 @@ public:
     if( _status != IDLE ){ return Error::BUSY; }
 
     FTP32_INFO("downloading %s", filename);
-    if( _openDataChn(_dClient) || _sendCmd("RETR", filename, 150) ) return _r_code;
+    if( _startTransfer("RETR", filename) ) return _r_code;
 
-    _readData(_dClient, dest);
+    _readData(_data(), dest);
+    _data().stop();
 
     return _readResponse() == 226 ? 0 : _r_code;
   }
@@ -340,13 +782,44 @@ public:
     if( _status != IDLE ){ return Error::BUSY; }
 
     FTP32_INFO("downloading %s", filename);
-    if( _openDataChn(_dClient) || _sendCmd("RETR", filename, 150) ) return _r_code;
+    if( _startTransfer("RETR", filename) ) return _r_code;
 
-    _readData(_dClient, dest);
+    _readData(_data(), dest);
+    _data().stop();
 
     return _readResponse() == 226 ? 0 : _r_code;
   }
   
+  /** @brief downloads several files back to back.
+    * PASV|EPSV for the next file is sent before 226 of the current one is read.
+    * Servers usually send 226 together with the end of data, so unlike uploadMany() it's about as fast as
+    * consecutive downloadSingleshot() calls (two round trips per file, see download_many_8 in examples/benchmark);
+    * it only gains when the server sends 226 late.
+    *
+    * @param[in] filenames files to download
+    * @param[out] dests place to load content of each file to
+    * @param[in] count number of files
+    *
+    * @note stops on the first failure; dests of the files before it are filled
+    * @see CommonReturnValues
+    **/
+  uint16_t downloadMany(const char* const* filenames, String* dests, size_t count){
+    if( _status != IDLE ){ return Error::BUSY; }
+
+    FTP32_INFO("downloading %d files", count);
+    if( count && _requestPassive() ) return _r_code;
+    for( size_t i = 0; i < count; ++i ){
+      if( _expectPassive("RETR", filenames[i]) ) return _r_code;
+
+      _readData(_data(), dests[i]);
+      _data().stop();
+
+      if( _finishPipelined(i + 1 < count) ) return _r_code;
+    }
+
+    return 0;
+  }
+  
   // DIR
   /** @brief creates new folder in the current working dir
     * 
@@ -369,6 +842,10 @@ public:
     * @see CommonReturnValues
     **/
   uint16_t mktree(const char* path) {
+    FTP32_INFO("making tree %s", path);
+    // with MLST each level is checked in one control round trip instead of a listing over a new data connection
+    bool mlst = hasFeature(Feature::MLST);
+    bool missing{false}; // once a level is missing, so are the ones below
     String p(path);
     String sub;
     String pathContentBuff;
@@ -386,14 +863,21 @@ public:
     }
 
     while( existingPath != p ){
-      if( listContent(existingPath.c_str(), ListType::SIMPLE, pathContentBuff) ) return _r_code;
+      if( !mlst && !missing && listContent(existingPath.c_str(), ListType::SIMPLE, pathContentBuff) ) return _r_code;
 
       right = p.indexOf('/', left);
       String nextToAdd = p.substring(left, right);
       left = right + 1; // skip /
       existingPath += nextToAdd;
       if( right != -1 ) existingPath += "/";
-      if( pathContentBuff.indexOf(existingPath) != -1 ) continue;
+      if( !missing ){
+        if( mlst ){
+          if( _writeCmd("MLST", existingPath.c_str()) ) return _r_code;
+          if( _readResponse() == 250 ) continue;
+          if( _r_code < 500 ) return _r_code; // 5xx means there's no such path
+        } else if( pathContentBuff.indexOf(existingPath) != -1 ) continue;
+        missing = true;
+      }
       if( mkdir(existingPath.c_str()) ) return _r_code;     
     }
 
@@ -407,8 +891,11 @@ public:
     * @see CommonReturnValues
     **/
   uint16_t changeDir(const char* path){
+    if( path[0] == '/' && _cwd == path ) return 0; // already there
     FTP32_INFO("changing cwd to %s", path);
-    return _sendCmd("CWD", path, 250);
+    if( _sendCmd("CWD", path, 250) ){ _cwd = ""; return _r_code; }
+    _cwd = path[0] == '/' ? path : ""; // relative paths aren't tracked
+    return 0;
   }
 
   /** @brief removes an empty dir in the current working dir
@@ -511,6 +998,7 @@ public:
     * @see CommonReturnValues
     **/
   uint16_t listContent(const char* dir, ListType t, String& dest){
+    if( _status != IDLE ){ return Error::BUSY; }
     FTP32_INFO("getting content of %s", dir);
     String cmd;
     switch(t){
@@ -518,6 +1006,7 @@ public:
         cmd = "LIST";
         break;
       case ListType::MACHINE:
+        if( _lacks(Feature::MLST) ) return Error::UNSUPPORTED;
         cmd = "MLSD";
         break;
       case ListType::SIMPLE:
@@ -527,12 +1016,10 @@ public:
         return Error::INVARG;
     }
     
-    WiFiClient tmp;
-    if( _openDataChn(tmp) ) return _r_code;
-
-    if( _sendCmd(cmd.c_str(), dir, 150) ) return _r_code;
+    if( _startTransfer(cmd.c_str(), dir) ) return _r_code;
 
-    _readData(tmp, dest);
+    _readData(_data(), dest);
+    _data().stop();
 
     return _readResponse() == 226 ? 0 : _r_code;
   }
@@ -540,12 +1027,14 @@ public:
   /** @brief sets transfer type for both upload and download operations.
     *
     * The default transfer type is binary (TYPE I)
+    * Repeated calls with the same type don't reach the server.
     *
     * @param[in] t transfer type to be used @see TransferType
     * 
     * @see CommonReturnValues
     **/
   uint16_t setTransferType(TransferType t){
+    if( _typeKnown && _type == t ) return 0;
     String type;
     switch(t){
       case TransferType::BINARY:
@@ -560,7 +1049,54 @@ public:
         return Error::INVARG;
     }
 
-    return _sendCmd(type.c_str(), 200);
+    if( _sendCmd(type.c_str(), 200) ){ _typeKnown = false; return _r_code; }
+    _type = t;
+    _typeKnown = true;
+    return 0;
+  }
+
+  /** @brief sets transfer mode for all following transfers, including listings.
+    *
+    * The default mode is STREAM (MODE S). DEFLATE (MODE Z) is only used if the server lists it in FEAT @see hasFeature().
+    * Compression uses the standard 32KiB deflate window, buffers are allocated on the first switch to DEFLATE:
+    * about 160KiB for the compressor and 44KiB for the decompressor (PSRAM recommended), 
+    * they are freed when switching back to STREAM.
+    * Repeated calls with the same mode don't reach the server, so it's cheap to set it before each transfer.
+    *
+    * @param[in] m transfer mode to be used @see TransferMode
+    * @param[in] level compression level 1-9, also passed to the server with OPTS MODE Z
+    * @note getLastTransferStats() shows whether it pays off
+    * @see CommonReturnValues
+    **/
+  uint16_t setTransferMode(TransferMode m, uint8_t level = 6){
+    if( _status != IDLE ) return Error::BUSY;
+    switch(m){
+      case TransferMode::STREAM:
+        if( _mode == m ) return 0;
+        FTP32_INFO("setting transfer mode to stream");
+        if( _sendCmd("MODE S", 200) ) return _r_code;
+        _mode = m;
+        _freeCodec();
+        return 0;
+      case TransferMode::DEFLATE:
+        if( _mode == m && _z_level == level ) return 0;
+        FTP32_INFO("setting transfer mode to deflate");
+        if( !hasFeature(Feature::MODE_Z) ) return Error::UNSUPPORTED; // no FEAT, no MODE Z
+        if( !_allocCodec() ) return Error::NOMEM;
+        if( _mode != m && _sendCmd("MODE Z", 200) ) return _r_code;
+        _mode = m;
+        _z_level = level;
+        // the level is only a hint for the server, it may not know OPTS MODE Z
+        _sendCmd("OPTS MODE Z LEVEL", String(level).c_str(), 200);
+        return 0;
+      default:
+        return Error::INVARG;
+    }
+  }
+
+  /** @return sizes and codec time of the last data transfer **/
+  TransferStats getLastTransferStats(){
+    return _t_stats;
   }
 
   /** @brief returns the last time the file was modified.
@@ -571,6 +1107,7 @@ public:
     * @see CommonReturnValues
     **/
   uint16_t getLastModificationDate(const char* filename, String& date){
+    if( _lacks(Feature::MDTM) ) return Error::UNSUPPORTED;
     FTP32_INFO("getting last modification date of %s", filename);
     return _sendCmd("MDTM", filename, 213);
   }
@@ -588,6 +1125,30 @@ public:
     return 0;
   }
 
+  /** @brief sends NOOP, keeps the session from being closed by the server for inactivity
+    * @see CommonReturnValues
+    **/
+  uint16_t noop(){
+    FTP32_INFO("noop");
+    return _sendCmd("NOOP", 200);
+  }
+
+  /** @brief requests passive mode and connects the data channel ahead of the next transfer.
+    * The next transfer (or listing) then starts with the transfer command only.
+    * A data channel opened this way is replaced if called again, so it can be refreshed periodically,
+    * since servers drop unused passive connections after a while.
+    *
+    * @see CommonReturnValues
+    **/
+  uint16_t preopenDataChannel(){
+    if( _status != IDLE ) return Error::BUSY;
+    _dropPreopened();
+    FTP32_INFO("preopening data channel");
+    if( _requestPassive() || _expectPassiveReply() || _connectPassive() ) return _r_code;
+    _data_ready = true;
+    return 0;
+  }
+
   // LIB CONFIG
   /** @brief sets the incoming control channel buffer max size.
     * @note some data like file size or data connectio address 
@@ -598,6 +1159,27 @@ public:
     _msg_buff_size = size;
   }
 
+  /** @brief enables explicit FTPS (AUTH TLS) starting with the next connectWithPassword().
+    * Both control and data channels are encrypted (PROT P), 
+    * data channels resume the control channel session instead of doing full handshakes.
+    * 
+    * @param[in] caCert PEM certificate the server is verified against
+    * @param[in] insecure must be set to use nullptr as caCert, disables verification (e.g. self-signed test server)
+    * @note getTlsStats() shows handshake timings
+    * @return Error::INVARG if there's no certificate and verification isn't explicitly disabled, 0 otherwise
+    **/
+  uint16_t useTls(const char* caCert, bool insecure = false){
+    if( !caCert && !insecure ) return Error::INVARG;
+    _tls = true;
+    _cTls.setCACert(caCert);
+    _dTls.setCACert(caCert);
+    if( insecure ){
+      _cTls.setInsecure();
+      _dTls.setInsecure();
+    }
+    return 0;
+  }
+
   /** @brief sets timeout for the data channel in milliseconds.
     *  Usually higher than for control channel
     **/ 
@@ -614,6 +1196,16 @@ public:
   
 
   // LIB DATA
+  /** @return whether the control channel is connected **/
+  bool isConnected(){
+    return _ctrl->connected();
+  }
+
+  /** @return current transaction state @see Status **/
+  Status getStatus(){
+    return _status;
+  }
+
   /** @return msg of the last response **/
   String getLastMsg(){
     return _r_msg;
@@ -624,7 +1216,28 @@ public:
     return _r_code;
   }
 
+  /** @brief tells whether the server listed the feature in FEAT reply.
+    * Features are requested once, right after login, and cached for the session.
+    * @note if the server doesn't support FEAT, nothing is reported, 
+    * but commands that depend on features are still tried (except MODE Z)
+    **/
+  bool hasFeature(Feature f){
+    return _features & f;
+  }
+
+  /** @return all features listed by the server @see Feature **/
+  uint16_t getFeatures(){
+    return _features;
+  }
+
+  /** @return handshake timings of the FTPS session **/
+  TlsStats getTlsStats(){
+    return _tls_stats;
+  }
+
 private:
+  template<size_t ChunkSize, uint8_t ChunkCount> friend class FTP32SegmentWriter;
+
   /** @brief Send command to FTP server. Checks for connection before sending.
     * @param[in] cmd The command to send.
     * @param[in] arg Command argument.
@@ -632,16 +1245,8 @@ private:
     * @see CommonReturnValues
     **/
   uint16_t _sendCmd(const char* cmd, const char* arg, uint16_t expectedResponseCode){
-    if( !_cClient.connected() ) { _r_code = Error::TIMEOUT; return _r_code; }
-
-    _cClient.println(String(cmd) + " " + String(arg));  
-
-    if( _readResponse() == expectedResponseCode ){
-      return 0;
-    } else {
-      FTP32_ERROR("%s %s FAILED %d %s", cmd, arg, _r_code, _r_msg.c_str());
-      return _r_code;
-    }
+    if( _writeCmd(cmd, arg) ) return _r_code;
+    return _expect(expectedResponseCode, cmd, arg);
   }
 
   /** @brief Send command to FTP server. Checks for connection before sending.
@@ -650,56 +1255,95 @@ private:
     * @see CommonReturnValues
     **/
   uint16_t _sendCmd(const char* cmd, uint16_t expectedResponseCode){
-    if( !_cClient.connected() ) { _r_code = Error::TIMEOUT; return _r_code; }
-   
-    _cClient.println(cmd);
+    if( _writeCmd(cmd) ) return _r_code;
+    return _expect(expectedResponseCode, cmd);
+  }
+
+  /** @brief Send command without waiting for the response.
+    * Used to pipeline commands; each one must be followed by _expect() later on.
+    * @param[in] cmd The command to send.
+    * @param[in] arg Command argument, may be nullptr.
+    * @see CommonReturnValues
+    **/
+  uint16_t _writeCmd(const char* cmd, const char* arg = nullptr){
+    if( !_ctrl->connected() ) { _r_code = Error::TIMEOUT; return _r_code; }
+
+    // single write, so a command is never split between TLS records or TCP segments
+    String line(cmd);
+    if( arg ){ line += ' '; line += arg; }
+    line += "\r\n";
+    _ctrl->print(line);
 
+    return 0;
+  }
+
+  /** @brief reads the next response and compares it against the expected code.
+    * @param[in] expectedResponseCode The expected response code.
+    * @param[in] cmd command the response belongs to (for logging only)
+    * @param[in] arg its argument (for logging only)
+    * @see CommonReturnValues
+    **/
+  uint16_t _expect(uint16_t expectedResponseCode, const char* cmd, const char* arg = ""){
     if( _readResponse() == expectedResponseCode ){
       return 0;
     } else {
-      FTP32_ERROR("%s FAILED %d %s", cmd, _r_code, _r_msg.c_str());
+      FTP32_ERROR("%s %s FAILED %d %s", cmd, arg, _r_code, _r_msg.c_str());
       return _r_code;
     }
   }
 
+  /** @brief reads a single line of the control channel dropping CRLF.
+    * Characters beyond the input buffer size are read but not stored.
+    *
+    * @param[out] dest line content
+    * @param[in] startTime timeout reference point
+    *
+    * @return false on timeout or disconnect
+    **/
+  bool _readLine(String& dest, int64_t startTime){
+    dest = "";
+    while( (esp_timer_get_time() - startTime) < _ctrl_timeout_us ){
+      if( _ctrl->available() ){
+        char c = _ctrl->read();
+        if( c == '\n' ) return true;
+        if( c != '\r' && dest.length() < _msg_buff_size ) dest += c;
+      } else {
+        if( !_ctrl->connected() ){ return false; }
+      }
+    }
+    return false;
+  }
+
   /** @brief Parses response data sent in the control channel.
     * 
     * Stores response code and response msg separately.
     * If the response msg is bigger than the buffer, trims it off.
+    * For multiline responses only the first line is stored, the rest is skipped.
+    * Only a single response is consumed, so pipelined responses stay in the channel.
+    *
+    * @param[out] lines if set, receives the lines between the first and the last one of a multiline response,
+    *   each followed by '\n'
     *
     * @return response code
     **/
-  uint16_t _readResponse(){
+  uint16_t _readResponse(String* lines = nullptr){
     _r_msg = "";
     _r_code = 0;
 
-    int i{};
-
-    // read the response
+    String line;
     int64_t startTime = esp_timer_get_time();
-    while( (esp_timer_get_time() - startTime) < _ctrl_timeout_us ){
-      if( _cClient.available() ){
-        char c = _cClient.read();
-        switch( i++ ){ // O stands for oPTimZiaTion
-          case 0: _r_code += (c - '0') * 100; break;
-          case 1: _r_code += (c - '0') * 10; break;
-          case 2: _r_code += (c - '0'); break;
-          case 3: break; // skip trailing space
-          default: // read msg
-          {
-            if( c == '\r' || i == _msg_buff_size ) { goto exit_loop; }
-            _r_msg += c;
-          }
-        }
-      } else {
-        if( !_cClient.connected() ){ _r_code = Error::TIMEOUT; break; }
-      }
-    }
-    exit_loop:;
+    if( !_readLine(line, startTime) || line.length() < 3 ){ _r_code = Error::TIMEOUT; return _r_code; }
+
+    _r_code = (line[0] - '0') * 100 + (line[1] - '0') * 10 + (line[2] - '0');
+    if( line.length() > 4 ) _r_msg = line.substring(4);
 
-    // discard the rest TODO
-    while( _cClient.available() ) {
-      _cClient.read();
+    if( line.length() > 3 && line[3] == '-' ){ // multiline, lasts until "xyz " line
+      String last = line.substring(0, 3) + ' ';
+      while( true ){
+        if( !_readLine(line, startTime) ){ _r_code = Error::TIMEOUT; break; }
+        if( line.startsWith(last) ) break;
+        if( lines ){ *lines += line; *lines += '\n'; }
+      }
     }
 
     return _r_code;
@@ -719,7 +1363,9 @@ private:
     * @return number of bytes read.
     **/
   template<typename T>
-  size_t _readData(WiFiClient& dataC, T& dest, size_t amount = 0){
+  size_t _readData(Client& dataC, T& dest, size_t amount = 0){
+    if( _mode == TransferMode::DEFLATE ) return _readInflated(dataC, dest, amount);
+
     size_t read{0};
     int64_t startTime = esp_timer_get_time();
     while( (esp_timer_get_time() - startTime) < _data_timeout_us ) {
@@ -730,33 +1376,261 @@ private:
         if( !dataC.connected() ) break;
       }
     }
+    _t_stats.payloadBytes += read;
+    _t_stats.wireBytes += read;
 
     return read;
   }
+
+  /** @brief MODE Z counterpart of _readData(); inflated data that doesn't fit into amount is kept for the next call
+    * @see _readData
+    **/
+  template<typename T>
+  size_t _readInflated(Client& dataC, T& dest, size_t amount){
+    size_t read{0};
+    int64_t startTime = esp_timer_get_time();
+    while( (esp_timer_get_time() - startTime) < _data_timeout_us ) {
+      if( amount && read == amount ) break;
+      if( _z_avail ){ // hand out what's already inflated
+        add(dest, _z_window[_z_out++], read++);
+        _z_avail--;
+        continue;
+      }
+      if( _z_status == TINFL_STATUS_DONE || _z_status < 0 ) break;
+
+      bool more{true};
+      if( _z_in_pos == _z_in_len ){
+        if( dataC.available() ){
+          int n = dataC.read(_z_buff, sizeof(_z_buff));
+          if( n <= 0 ) continue;
+          _z_in_len = n;
+          _z_in_pos = 0;
+          _t_stats.wireBytes += n;
+        } else if( dataC.connected() ){
+          continue;
+        } else {
+          more = false;
+        }
+      }
+
+      size_t in = _z_in_len - _z_in_pos;
+      size_t out = TINFL_LZ_DICT_SIZE - _z_dict_pos;
+      int64_t codecStart = esp_timer_get_time();
+      _z_status = tinfl_decompress(_inflate, _z_buff + _z_in_pos, &in, _z_window, _z_window + _z_dict_pos, &out, 
+                                   TINFL_FLAG_PARSE_ZLIB_HEADER | (more ? TINFL_FLAG_HAS_MORE_INPUT : 0));
+      _t_stats.codecUs += esp_timer_get_time() - codecStart;
+      _z_in_pos += in;
+      _z_out = _z_dict_pos;
+      _z_avail = out;
+      _z_dict_pos = (_z_dict_pos + out) & (TINFL_LZ_DICT_SIZE - 1);
+      if( _z_status < 0 ){ FTP32_ERROR("inflate failed %d", _z_status); }
+      if( !more && !out && _z_status != TINFL_STATUS_DONE ) break; // truncated stream
+    }
+    _t_stats.payloadBytes += read;
+
+    return read;
+  }
+
+  /** @brief writes to the data channel applying the transfer mode
+    * @return number of payload bytes accepted
+    **/
+  size_t _writeData(const uint8_t* data, size_t size){
+    if( _mode != TransferMode::DEFLATE ){
+      size_t written = _data().write(data, size);
+      _t_stats.payloadBytes += written;
+      _t_stats.wireBytes += written;
+      return written;
+    }
+    return _deflate(data, size, TDEFL_NO_FLUSH) ? 0 : size;
+  }
+
+  /** @brief flushes the compressor at the end of an upload, no-op in STREAM mode **/
+  uint16_t _finishData(){
+    if( _mode != TransferMode::DEFLATE ) return 0;
+    return _deflate(nullptr, 0, TDEFL_FINISH);
+  }
+
+  /** @brief feeds the compressor and writes its output to the data channel
+    * @see CommonReturnValues
+    **/
+  uint16_t _deflate(const uint8_t* data, size_t size, tdefl_flush flush){
+    size_t consumed{};
+    while( true ){
+      size_t in = size - consumed;
+      size_t out = sizeof(_z_buff);
+      int64_t codecStart = esp_timer_get_time();
+      tdefl_status st = tdefl_compress(_deflator, data ? data + consumed : nullptr, &in, _z_buff, &out, flush);
+      _t_stats.codecUs += esp_timer_get_time() - codecStart;
+      consumed += in;
+      if( st < 0 ){ FTP32_ERROR("deflate failed %d", st); return Error::INVARG; }
+      if( out && _data().write(_z_buff, out) != out ) return Error::TIMEOUT;
+      _t_stats.wireBytes += out;
+      // compressor might hold more output than the buffer fits
+      if( st == TDEFL_STATUS_DONE || (consumed == size && out < sizeof(_z_buff) && flush != TDEFL_FINISH) ) break;
+    }
+    _t_stats.payloadBytes += size;
+    return 0;
+  }
+
+  /** @brief resets transfer stats and codec state, called for each new data connection **/
+  void _beginTransfer(){
+    _t_stats = TransferStats{};
+    if( _mode != TransferMode::DEFLATE ) return;
+
+    // same probe counts miniz uses for zlib levels
+    static const uint16_t probes[] = {0, 1, 6, 32, 16, 32, 128, 256, 512, 768, 1500};
+    tdefl_init(_deflator, nullptr, nullptr, probes[_z_level > 10 ? 10 : _z_level] | TDEFL_WRITE_ZLIB_HEADER);
+    tinfl_init(_inflate);
+    _z_status = TINFL_STATUS_NEEDS_MORE_INPUT;
+    _z_in_pos = _z_in_len = 0;
+    _z_dict_pos = _z_out = _z_avail = 0;
+  }
+
+  bool _allocCodec(){
+    if( !_deflator ) _deflator = (tdefl_compressor*)malloc(sizeof(tdefl_compressor));
+    if( !_inflate ) _inflate = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+    if( !_z_window ) _z_window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+    if( _deflator && _inflate && _z_window ) return true;
+    FTP32_ERROR("not enough memory for deflate");
+    _freeCodec();
+    return false;
+  }
+
+  void _freeCodec(){
+    free(_deflator); _deflator = nullptr;
+    free(_inflate); _inflate = nullptr;
+    free(_z_window); _z_window = nullptr;
+  }
+
+  /** @brief requests FEAT and caches features for the session
+    * @see CommonReturnValues
+    **/
+  uint16_t _discoverFeatures(){
+    _features = 0;
+    _feat_known = false;
+
+    String feat;
+    if( _writeCmd("FEAT") ) return _r_code;
+    if( _readResponse(&feat) != 211 ){
+      FTP32_INFO("FEAT isn't supported %d", _r_code);
+      return _r_code;
+    }
+    _feat_known = true;
+
+    static const struct { const char* name; Feature f; } known[] = {
+      {"MLST", Feature::MLST}, {"SIZE", Feature::SIZE}, {"REST STREAM", Feature::REST},
+      {"EPSV", Feature::EPSV}, {"UTF8", Feature::UTF8}, {"HASH", Feature::HASH},
+      {"MODE Z", Feature::MODE_Z}, {"MDTM", Feature::MDTM}
+    };
+    unsigned startPos{}; // every line ends with \n, so indexOf() below always finds one
+    while( startPos < feat.length() ){
+      int endPos = feat.indexOf('\n', startPos);
+      String line = feat.substring(startPos, endPos);
+      line.trim();
+      line.toUpperCase();
+      for( auto& k : known ){
+        // whole word only, so "SIZE" doesn't match "SIZEX"
+        if( line.startsWith(k.name) && (line.length() == strlen(k.name) || line[strlen(k.name)] == ' ') ) _features |= k.f;
+      }
+      startPos = endPos + 1;
+    }
+    FTP32_INFO("features 0x%x", _features);
+
+    return 0;
+  }
+
+  /** @return whether FEAT reply is known and doesn't list the feature, so the command shouldn't be tried **/
+  bool _lacks(Feature f){
+    if( !_feat_known || (_features & f) ) return false;
+    FTP32_ERROR("server doesn't support %x", f);
+    return true;
+  }
   
-  /** @brief establishes passive connection for data transmission.
+  /** @brief establishes passive connection and starts the transfer
     * 
-    * @param[in] client the one is going to be used for data connection
+    * @param[in] cmd transfer command (STOR, APPE, RETR, LIST...)
+    * @param[in] arg its argument
     * 
     * @see CommonReturnValues
     **/
-  uint16_t _openDataChn(WiFiClient& client){
-    if( _sendCmd("PASV", 227) ) return _r_code;
+  uint16_t _startTransfer(const char* cmd, const char* arg){
+    if( _data_ready ){ // @see preopenDataChannel()
+      _data_ready = false;
+      if( _dTransport->connected() ){
+        _beginTransfer();
+        if( _writeCmd(cmd, arg) ) return _r_code;
+        return _expectTransferStart(cmd, arg);
+      }
+      _dTransport->stop();
+    }
+    if( _requestPassive() ) return _r_code;
+    return _expectPassive(cmd, arg);
+  }
+
+  /** @brief closes the data channel opened by preopenDataChannel() if it wasn't used **/
+  void _dropPreopened(){
+    if( !_data_ready ) return;
+    _data_ready = false;
+    _dTransport->stop();
+  }
+
+  /** @brief sends EPSV if the server has it, PASV otherwise, without waiting for the response.
+    * EPSV reply carries just the port, so it's cheaper to parse and works behind NAT.
+    * @see CommonReturnValues
+    **/
+  uint16_t _requestPassive(){
+    return _writeCmd(hasFeature(Feature::EPSV) ? "EPSV" : "PASV");
+  }
+
+  /** @brief expects reply to _requestPassive()
+    * @see CommonReturnValues
+    **/
+  uint16_t _expectPassiveReply(){
+    if( hasFeature(Feature::EPSV) ) return _expect(229, "EPSV");
+    return _expect(227, "PASV");
+  }
+
+  /** @brief connects the data channel (TCP only) to the address from the last 229|227 response.
+    * @see CommonReturnValues
+    **/
+  uint16_t _connectPassive(){
+    if( _r_code == 229 ){ // (|||port|), host is the one of the control connection
+      int startPos = _r_msg.indexOf("|||");
+      int endPos = startPos == -1 ? -1 : _r_msg.indexOf('|', startPos + 3);
+      if( endPos == -1 ){
+        FTP32_ERROR("malformed passive reply %s", _r_msg.c_str());
+        return _r_code;
+      }
+      IPAddress host;
+      if( _cTransport == &_cClient ) host = _cClient.remoteIP();
+      else host.fromString(_address);
+      return _connectData(host, atoi(_r_msg.c_str() + startPos + 3));
+    }
 
     int startPos = _r_msg.indexOf("(");
     int endPos = _r_msg.indexOf(")");
     int parts[6]; // adress part 0-3 is ip, 4-5 is port
+    int partCount{};
     if (startPos != -1 && endPos != -1) {
       String portStr = _r_msg.substring(startPos + 1, endPos);
-      int partCount{};
       char* token = strtok(const_cast<char*>(portStr.c_str()), ",");
-      while (token) {
+      while (token && partCount < 6) {
         parts[partCount++] = atoi(token);
         token = strtok(NULL, ",");
       }
     }
+    if( partCount != 6 ){
+      FTP32_ERROR("malformed passive reply %s", _r_msg.c_str());
+      return _r_code;
+    }
 
-    if( !client.connect(IPAddress(parts[0], parts[1], parts[2], parts[3]), (parts[4] << 8) | (parts[5] & 255), _ctrl_timeout_us/1e3) ){
+    return _connectData(IPAddress(parts[0], parts[1], parts[2], parts[3]), (parts[4] << 8) | (parts[5] & 255));
+  }
+
+  uint16_t _connectData(IPAddress ip, uint16_t port){
+    _dropPreopened();
+    _beginTransfer();
+    if( !_connectTransport(*_dTransport, _dClient, ip, port) ){
       FTP32_ERROR("data connection cannot be established");
       return _r_code;
     } else {
@@ -765,6 +1639,161 @@ private:
     }
   }
 
+  /** @brief second half of a pipelined transfer start.
+    * Expects the reply of an already sent PASV|EPSV, sends the transfer command, 
+    * connects the data channel and expects 150.
+    *
+    * @param[in] cmd transfer command (STOR, APPE, RETR...)
+    * @param[in] arg its argument
+    *
+    * @see CommonReturnValues
+    **/
+  uint16_t _expectPassive(const char* cmd, const char* arg){
+    if( _expectPassiveReply() || _writeCmd(cmd, arg) ) return _r_code;
+    if( _connectPassive() ) return _cancelTransferStart();
+    return _expectTransferStart(cmd, arg);
+  }
+
+  /** @brief gets the control channel back in sync after the transfer command was sent, 
+    * but the data channel couldn't be set up.
+    * Server replies to the command only after its own accept timeout (60s for vsftpd), 
+    * so ABOR is sent and replies are read up to the one to ABOR.
+    * If it doesn't come in time, the session is dropped, late replies would be taken for the ones of later commands.
+    *
+    * @return code of the server's failure reply if there was one, Error::TIMEOUT otherwise
+    **/
+  uint16_t _cancelTransferStart(){
+    uint16_t failure{};
+    String msg;
+    if( !_writeCmd("ABOR") ){
+      while( _readResponse() != Error::TIMEOUT ){
+        // 225 is ABOR with nothing to abort, 226 comes after 4xx|5xx of the aborted command
+        if( _r_code == 225 || (_r_code == 226 && failure) ){
+          _r_code = failure ? failure : (uint16_t)Error::TIMEOUT;
+          _r_msg = msg;
+          return _r_code;
+        }
+        if( _r_code >= 400 && !failure ){ failure = _r_code; msg = _r_msg; }
+      }
+    }
+    FTP32_FATAL("transfer can't be cancelled, dropping the session");
+    _dropSession();
+    _r_code = failure ? failure : (uint16_t)Error::TIMEOUT;
+    _r_msg = msg;
+    return _r_code;
+  }
+
+  /** @brief closes the control channel without QUIT, when the session is out of sync **/
+  void _dropSession(){
+    _dropPreopened();
+    _ctrl->stop();
+    _ctrl = _cTransport;
+    _prot_p = false;
+    _forgetTlsSession();
+  }
+
+  /** @brief last step of a transfer start, the command is sent and the data channel is connected.
+    * @see CommonReturnValues
+    **/
+  uint16_t _expectTransferStart(const char* cmd, const char* arg){
+    if( _secureData() ) return _cancelTransferStart(); // server may have sent 150 already, its failure reply follows
+    return _expect(150, cmd, arg);
+  }
+
+  /** @brief PROT P handshake on the connected data channel, no-op without TLS.
+    * Must go after the transfer command, servers don't start TLS on the data channel before it.
+    * @see CommonReturnValues
+    **/
+  uint16_t _secureData(){
+    if( !_prot_p ) return 0;
+    if( !_tls_session_saved ) _tls_session_saved = !_cTls.getSession(&_tls_session);
+
+    int64_t startTime = esp_timer_get_time();
+    int ret = _dTls.handshake(_address, _tls_session_saved ? &_tls_session : nullptr, _ctrl_timeout_us);
+    int64_t duration = esp_timer_get_time() - startTime;
+    if( ret ){
+      FTP32_ERROR("data channel TLS handshake failed -0x%x", -ret);
+      _dTransport->stop();
+      return _r_code ? _r_code : (uint16_t)Error::TIMEOUT;
+    }
+    _tls_stats.lastDataHandshakeUs = duration;
+    _tls_stats.totalDataHandshakeUs += duration;
+    _tls_stats.dataHandshakes++;
+    return 0;
+  }
+
+  /** @brief AUTH TLS and the control channel handshake
+    * @see CommonReturnValues
+    **/
+  uint16_t _startTls(){
+    if( _sendCmd("AUTH TLS", 234) ) return _r_code;
+
+    _forgetTlsSession();
+    int64_t startTime = esp_timer_get_time();
+    int ret = _cTls.handshake(_address, nullptr, _ctrl_timeout_us);
+    _tls_stats = TlsStats{};
+    _tls_stats.controlHandshakeUs = esp_timer_get_time() - startTime;
+    if( ret ){
+      FTP32_FATAL("control channel TLS handshake failed -0x%x", -ret);
+      _cTransport->stop();
+      _r_code = Error::TIMEOUT;
+      return _r_code;
+    }
+    _ctrl = &_cTls;
+    return 0;
+  }
+
+  void _forgetTlsSession(){
+    mbedtls_ssl_session_free(&_tls_session);
+    mbedtls_ssl_session_init(&_tls_session);
+    _tls_session_saved = false;
+  }
+
+  /** @return data channel as seen by transfers, TLS one under PROT P **/
+  Client& _data(){
+    if( _prot_p ) return _dTls;
+    return *_dTransport;
+  }
+
+  /** @brief connects the transport, applying the control channel timeout to own WiFiClients
+    * @return result of connect()
+    **/
+  template<typename Host>
+  int _connectTransport(Client& transport, WiFiClient& own, Host host, uint16_t port){
+    if( &transport == &own ) return own.connect(host, port, _ctrl_timeout_us/1e3);
+    return transport.connect(host, port);
+  }
+
+  /** @brief aborts a transfer whose final response hasn't been read yet.
+    * Server replies 426 (aborted) or 226 (already done) for the transfer and then 225/226 for ABOR,
+    * or just 225 if there's nothing to abort.
+    **/
+  void _abortTransfer(){
+    if( _writeCmd("ABOR") ) return;
+    if( _readResponse() != 225 ) _readResponse();
+  }
+
+  /** @brief expects 226 of the current transfer, optionally pipelining PASV|EPSV for the next one.
+    * 
+    * @param[in] next whether PASV|EPSV for the next transfer should be sent
+    * 
+    * @see CommonReturnValues
+    **/
+  uint16_t _finishPipelined(bool next){
+    if( next && _requestPassive() ) return _r_code;
+    if( _expect(226, "transfer") ){
+      if( next ){ // don't leave 227|229 in the channel, but keep the failure visible
+        uint16_t code = _r_code;
+        String msg = _r_msg;
+        _readResponse();
+        _r_code = code;
+        _r_msg = msg;
+      }
+      return _r_code;
+    }
+    return 0;
+  }
+
   // overloads for differnt incoming data buffer types
   void add(String& str, char c, size_t pos){ str += c; }
   void add(char* str, char c, size_t pos){ str[pos] = c; }
@@ -773,13 +1802,45 @@ private:
 private:
   WiFiClient _cClient;
   WiFiClient _dClient;
+  Client* _cTransport{&_cClient}; ///< raw control connection, own client unless a custom one is given
+  Client* _dTransport{&_dClient}; ///< raw data connection, same as above
+  Client* _ctrl{_cTransport}; ///< control channel as seen by commands, TLS one after AUTH TLS
+
+  // FTPS
+  FTP32TlsClient _cTls{_cClient};
+  FTP32TlsClient _dTls{_dClient};
+  bool _tls{false};    ///< useTls() was called
+  bool _prot_p{false}; ///< data channels are encrypted
+  mbedtls_ssl_session _tls_session; ///< control channel session, resumed by data channels
+  bool _tls_session_saved{false};
+  TlsStats _tls_stats{};
   Status _status{Status::IDLE};
+  bool _data_ready{false}; ///< data channel is connected by preopenDataChannel()
 
   uint8_t _msg_buff_size{60};
 
   uint16_t _r_code;
   String _r_msg;
 
+  // avoid resending session state that's already in place
+  TransferType _type{TransferType::BINARY};
+  bool _typeKnown{false};
+  String _cwd; ///< absolute CWD if known, empty otherwise
+  uint16_t _features{};    ///< @see Feature
+  bool _feat_known{false}; ///< FEAT reply was received
+
+  // MODE Z state
+  TransferMode _mode{TransferMode::STREAM};
+  uint8_t _z_level{6};
+  tdefl_compressor* _deflator{nullptr};
+  tinfl_decompressor* _inflate{nullptr};
+  uint8_t* _z_window{nullptr}; ///< inflate dictionary, inflated data is handed out from here
+  uint8_t _z_buff[512];        ///< compressed side of both directions
+  size_t _z_in_pos{}, _z_in_len{};
+  size_t _z_dict_pos{}, _z_out{}, _z_avail{};
+  tinfl_status _z_status{TINFL_STATUS_DONE};
+  TransferStats _t_stats{};
+
   const char* _address; 
   const uint8_t _port;
   
@@ -790,4 +1851,417 @@ private:
   int64_t _data_timeout_us;
 };
 
+/** @brief Continuous upload split into segments.
+  * 
+  * Each segment is uploaded under a temporary name (final name + ".part") 
+  * and renamed to the final one once complete, so consumers never see partial files.
+  * On rotation the next segment's data channel is opened before the previous one is published, 
+  * and rename + STOR of the next segment are pipelined.
+  * 
+  * Written data is coalesced into ChunkCount buffers of ChunkSize bytes, which is the only memory used for payload.
+  * Thresholds are checked before each write, so a single write is never split between segments.
+  * If the transfer of a segment fails, the segment is dropped (its temporary file is deleted) and a new one is started.
+  * 
+  * @tparam ChunkSize size of a single buffer, default fits into a single TCP segment
+  * @tparam ChunkCount number of buffers
+  **/
+template<size_t ChunkSize = 1436, uint8_t ChunkCount = 4>
+class FTP32SegmentWriter{
+public:
+  struct Stats{
+    uint32_t published;       ///< segments made visible under the final name
+    uint32_t failed;          ///< segments lost to transfer or rename errors
+    uint64_t bytes;           ///< payload of published segments
+    int64_t lastPublishUs;    ///< time from rotation start to the final name being in place
+    int64_t maxPublishUs;
+    uint32_t lastThroughput;  ///< bytes/s of the last published segment, over the time spent sending it (writes and waiting for 226)
+  };
+
+  /** @param[in] ftp connected client, it's unavailable for other transfers until end()
+    * @param[in] pathPrefix segment N is named pathPrefix + N + extension
+    * @param[in] extension see above
+    * @param[in] maxSegmentSize rotate once the segment reaches this size, 0 to disable
+    * @param[in] maxSegmentMs rotate once the segment is that old, 0 to disable
+    **/
+  FTP32SegmentWriter(FTP32& ftp, const char* pathPrefix, const char* extension, size_t maxSegmentSize, uint32_t maxSegmentMs = 0)
+    : _ftp(ftp), _prefix(pathPrefix), _ext(extension), _max_size(maxSegmentSize), _max_age_us(maxSegmentMs * 1e3){
+  }
+
+  FTP32SegmentWriter(const FTP32SegmentWriter&) = delete;
+
+  /** @brief publishes the open segment, so the client isn't left in the middle of an upload **/
+  ~FTP32SegmentWriter(){
+    end();
+  }
+
+  /** @brief opens the first segment
+    * @param[in] firstIndex number of the first segment
+    * @see CommonReturnValues
+    **/
+  uint16_t begin(uint32_t firstIndex = 0){
+    if( _open || _ftp._status != FTP32::Status::IDLE ) return FTP32::Error::BUSY;
+    _idx = firstIndex;
+    _publish = false;
+    FTP32_INFO("starting segments %s%d%s", _prefix, _idx, _ext);
+    if( _ftp._requestPassive() ) return _ftp._r_code;
+    return _openSegment();
+  }
+
+  /** @brief appends data to the current segment, rotating first if a threshold is reached
+    * @return number of bytes accepted; less than size means the writer is closed due to a control channel error
+    **/
+  size_t write(const uint8_t* data, size_t size){
+    if( !_open ) return 0;
+    if( _due() && rotate() ) return 0;
+
+    size_t done{};
+    while( done < size ){
+      uint8_t tail = (_head + _used + ChunkCount - 1) % ChunkCount;
+      if( !_used || _fill[tail] == ChunkSize ){
+        if( _used == ChunkCount && _flushOldest() ){
+          if( _restart() ) return 0;
+          done = 0; // the whole write goes to the new segment
+          continue;
+        }
+        tail = (_head + _used++) % ChunkCount;
+        _fill[tail] = 0;
+      }
+      size_t n = min(ChunkSize - _fill[tail], size - done);
+      memcpy(_chunks[tail] + _fill[tail], data + done, n);
+      _fill[tail] += n;
+      done += n;
+    }
+    _seg_bytes += done;
+
+    return done;
+  }
+
+  /** @brief finishes the current segment, starts the next one and publishes the finished one
+    * @see CommonReturnValues
+    **/
+  uint16_t rotate(){
+    if( !_open ) return 0;
+    _rotation_start = esp_timer_get_time();
+    if( _finishSegment(true) ) return _restart();
+    _publish = true;
+    _idx++;
+    return _openSegment();
+  }
+
+  /** @brief finishes and publishes the current segment
+    * @see CommonReturnValues
+    **/
+  uint16_t end(){
+    if( !_open ) return _publishPending(); // the last rotation couldn't start the next segment
+    _rotation_start = esp_timer_get_time();
+    if( _finishSegment(false) ) return _ftp._r_code;
+
+    _publish = true;
+    _idx++;
+    return _publishPending();
+  }
+
+  Stats getStats(){
+    return _stats;
+  }
+
+  /** @return number of the segment being written **/
+  uint32_t getSegmentIndex(){
+    return _idx;
+  }
+
+private:
+  String _name(uint32_t idx, bool temporary){
+    String n = String(_prefix) + String(idx) + _ext;
+    if( temporary ) n += ".part";
+    return n;
+  }
+
+  bool _due(){
+    return (_max_size && _seg_bytes >= _max_size)
+      || (_max_age_us && esp_timer_get_time() - _seg_start >= _max_age_us);
+  }
+
+  /** @brief expects reply of a sent PASV|EPSV, connects and starts STOR of the current segment,
+    * publishing the previous one in between if needed
+    **/
+  uint16_t _openSegment(){
+    _open = false;
+    if( _ftp._expectPassiveReply() || _ftp._connectPassive() ) return _failOpen();
+
+    String tmp = _name(_idx, true);
+    String prevTmp = _name(_idx - 1, true);
+    String prevFinal = _name(_idx - 1, false);
+    if( _publish ){ // data channel is up, rename and STOR go out together
+      if( _ftp._writeCmd("RNFR", prevTmp.c_str()) 
+        || _ftp._writeCmd("RNTO", prevFinal.c_str()) ) return _failOpen();
+    }
+    if( _ftp._writeCmd("STOR", tmp.c_str()) ) return _failOpen();
+    bool secured = !_ftp._secureData();
+
+    if( _publish ){
+      uint16_t rnfr = _ftp._expect(350, "RNFR", prevTmp.c_str());
+      if( _ftp._expect(250, "RNTO", prevFinal.c_str()) || rnfr ){
+        _stats.failed++;
+      } else {
+        _published();
+      }
+      _publish = false;
+    }
+    if( !secured ) return _ftp._cancelTransferStart();
+    if( _ftp._expect(150, "STOR", tmp.c_str()) ){ 
+      _ftp._data().stop(); 
+      return _ftp._r_code;
+    }
+
+    _ftp._status = FTP32::Status::UPLOADING;
+    _open = true;
+    _seg_start = esp_timer_get_time();
+    _seg_send_us = 0;
+    _seg_bytes = 0;
+    _head = 0;
+    _used = 0;
+    return 0;
+  }
+
+  /** @brief publishes the previous segment if it's still pending, when the next one couldn't be opened
+    * @return code of the failed opening
+    **/
+  uint16_t _failOpen(){
+    uint16_t code = _ftp._r_code;
+    _ftp._dTransport->stop();
+    _publishPending();
+    _ftp._r_code = code;
+    return code;
+  }
+
+  /** @brief renames the previous segment to its final name without pipelining
+    * @see CommonReturnValues
+    **/
+  uint16_t _publishPending(){
+    if( !_publish ) return 0;
+    _publish = false;
+    String tmp = _name(_idx - 1, true);
+    String finalName = _name(_idx - 1, false);
+    if( _ftp._sendCmd("RNFR", tmp.c_str(), 350) || _ftp._sendCmd("RNTO", finalName.c_str(), 250) ){
+      _stats.failed++;
+      return _ftp._r_code;
+    }
+    _published();
+    return 0;
+  }
+
+  /** @brief sends the buffered data and expects 226, optionally pipelining PASV for the next segment **/
+  uint16_t _finishSegment(bool next){
+    while( _used ){
+      if( _flushOldest() ) break;
+    }
+    int64_t finishStart = esp_timer_get_time();
+    bool lost = _used || _ftp._finishData();
+    _ftp._data().stop();
+    _ftp._status = FTP32::Status::IDLE;
+    _open = false;
+    if( lost ){ // data is lost anyway, let the server finish
+      _ftp._readResponse();
+      return _ftp._r_code ? _ftp._r_code : (uint16_t)FTP32::Error::TIMEOUT;
+    }
+    if( _ftp._finishPipelined(next) ) return _ftp._r_code;
+
+    _seg_send_us += esp_timer_get_time() - finishStart;
+    return 0;
+  }
+
+  uint16_t _flushOldest(){
+    int64_t startTime = esp_timer_get_time();
+    size_t written = _ftp._writeData(_chunks[_head], _fill[_head]);
+    _seg_send_us += esp_timer_get_time() - startTime;
+    if( written != _fill[_head] ){
+      FTP32_ERROR("segment %d transfer failed", _idx);
+      return FTP32::Error::TIMEOUT;
+    }
+    _head = (_head + 1) % ChunkCount;
+    _used--;
+    return 0;
+  }
+
+  /** @brief drops the current segment and starts over under the next number **/
+  uint16_t _restart(){
+    if( _open ) _finishSegment(false);
+    _stats.failed++;
+    _publish = false;
+    _ftp._sendCmd("DELE", _name(_idx, true).c_str(), 250);
+    _idx++;
+    if( _ftp._requestPassive() ) return _ftp._r_code;
+    return _openSegment();
+  }
+
+  void _published(){
+    int64_t now = esp_timer_get_time();
+    _stats.published++;
+    _stats.bytes += _seg_bytes;
+    _stats.lastPublishUs = now - _rotation_start;
+    if( _stats.lastPublishUs > _stats.maxPublishUs ) _stats.maxPublishUs = _stats.lastPublishUs;
+    _stats.lastThroughput = _seg_send_us > 0 ? (uint64_t)_seg_bytes * 1000000 / _seg_send_us : 0;
+  }
+
+private:
+  FTP32& _ftp;
+  const char* _prefix;
+  const char* _ext;
+  size_t _max_size;
+  int64_t _max_age_us;
+
+  uint8_t _chunks[ChunkCount][ChunkSize];
+  size_t _fill[ChunkCount]{};
+  uint8_t _head{}; ///< oldest buffer
+  uint8_t _used{}; ///< buffers holding data, the last one might be partially filled
+
+  uint32_t _idx{};
+  bool _open{false};
+  bool _publish{false}; ///< previous segment waits for rename
+  size_t _seg_bytes{};
+  int64_t _seg_start{};
+  int64_t _seg_send_us{}; ///< time spent in writes and waiting for 226 of the current segment
+  int64_t _rotation_start{};
+
+  Stats _stats{};
+};
+
+/** @brief Keeps a second logged in session warm, so a transfer doesn't wait for connect and login.
+  * 
+  * The standby session is refreshed with NOOP and optionally holds a pre-opened data channel.
+  * promote() swaps it with the active one immediately, the other session becomes the standby
+  * and is reconnected by poll() if it's broken.
+  * Call poll() from loop(). It runs in the caller, there is no background task:
+  * reconnecting the standby blocks loop() for the duration of connect + login.
+  * Refreshes and reconnection attempts happen at most once per keep-alive period, even if the server is unreachable.
+  * 
+  * Both sessions are owned by the caller, so they can be configured the same way (timeouts, TLS, transfer type...),
+  * either one may become active.
+  * 
+  * @note always get the session through active(), it changes on promotion
+  **/
+class FTP32HotStandby{
+public:
+  struct Stats{
+    uint32_t promotions;
+    uint32_t replenishments; ///< standby (re)connections
+    uint32_t urgentUploads;
+    uint32_t fallbacks;      ///< urgent uploads that went back to the previous active session
+    int64_t lastTtfbUs;      ///< time from uploadUrgent() call to the first payload byte written
+    int64_t maxTtfbUs;
+  };
+
+  /** @param[in] first session to start as the active one, not connected yet, should outlive the object
+    * @param[in] second session to start as the standby one, same server and configuration as the first one
+    * @param[in] username user name, should outlive the object
+    * @param[in] password password, should outlive the object
+    * @param[in] keepAliveMs how often the standby is refreshed (or reconnection is retried)
+    * @param[in] preopenData keep a data channel of the standby connected (refreshed at the same rate)
+    **/
+  FTP32HotStandby(FTP32& first, FTP32& second, const char* username, const char* password, 
+                  uint32_t keepAliveMs = 30000, bool preopenData = false)
+    : _active(&first), _standby(&second), _user(username), _pass(password), 
+      _keep_alive_us(keepAliveMs * 1e3), _preopen(preopenData){
+  }
+
+  /** @brief connects both sessions
+    * @return result of the active session connection, the standby one is retried by poll()
+    **/
+  uint16_t begin(){
+    uint16_t res = _active->connectWithPassword(_user, _pass);
+    _refresh();
+    return res;
+  }
+
+  /** @brief keeps the standby session alive, reconnects it if needed **/
+  void poll(){
+    if( _standby->getStatus() != FTP32::Status::IDLE ) return;
+    if( esp_timer_get_time() - _last_refresh < _keep_alive_us ) return;
+    _refresh();
+  }
+
+  /** @brief makes the standby session active
+    * @return 0 if the new active session is connected, Error::TIMEOUT otherwise
+    **/
+  uint16_t promote(){
+    FTP32_INFO("promoting standby session");
+    std::swap(_active, _standby);
+    _stats.promotions++;
+    _last_refresh = 0; // let poll() check the new standby right away
+    return _active->isConnected() ? 0 : FTP32::Error::TIMEOUT;
+  }
+
+  /** @brief uploads on the warm session, promoting the standby if it's ready.
+    * If the promoted session can't start the upload (e.g. stale data channel), 
+    * the previous active one is used instead.
+    * @see FTP32::uploadSingleshot
+    **/
+  uint16_t uploadUrgent(const char* destinationFilepath, const uint8_t* data, size_t size, 
+                        FTP32::OpenType t = FTP32::OpenType::CREATE_REPLACE){
+    int64_t startTime = esp_timer_get_time();
+    bool promoted{false};
+    if( _ready(*_standby) ){ promote(); promoted = true; }
+
+    uint16_t res = _active->initUpload(destinationFilepath, t);
+    if( res && promoted && _ready(*_standby) ){
+      FTP32_ERROR("promoted session failed %d, falling back", res);
+      std::swap(_active, _standby);
+      _stats.fallbacks++;
+      res = _active->initUpload(destinationFilepath, t);
+    }
+    if( res ) return res;
+
+    FTP32& s = *_active;
+
+    size_t first = min(size, (size_t)1436); // one TCP segment is enough to tell the first byte is out
+    size_t written = s.uploadData(data, first);
+    _stats.urgentUploads++;
+    _stats.lastTtfbUs = esp_timer_get_time() - startTime;
+    if( _stats.lastTtfbUs > _stats.maxTtfbUs ) _stats.maxTtfbUs = _stats.lastTtfbUs;
+
+    if( written == first && size > first ) written += s.uploadData(data + first, size - first);
+    res = s.finishUpload();
+    if( res ) return res;
+    return written == size ? 0 : FTP32::Error::TIMEOUT;
+  }
+
+  /** @return session to be used for regular operations **/
+  FTP32& active(){
+    return *_active;
+  }
+
+  Stats getStats(){
+    return _stats;
+  }
+
+private:
+  bool _ready(FTP32& s){
+    return s.isConnected() && s.getStatus() == FTP32::Status::IDLE;
+  }
+
+  void _refresh(){
+    _last_refresh = esp_timer_get_time();
+    if( !_standby->isConnected() || _standby->noop() ){
+      FTP32_INFO("replenishing standby session");
+      _standby->disconnect();
+      if( _standby->connectWithPassword(_user, _pass) ) return;
+      _stats.replenishments++;
+    }
+    if( _preopen ) _standby->preopenDataChannel();
+  }
+
+private:
+  FTP32* _active;
+  FTP32* _standby;
+
+  const char* _user;
+  const char* _pass;
+  int64_t _keep_alive_us;
+  bool _preopen;
+  int64_t _last_refresh{};
+
+  Stats _stats{};
+};
+
 #endif // FTP32_H
@@ -0,0 +1,358 @@
+#ifndef FTP32_REPLAY_H
+#define FTP32_REPLAY_H
+
+// Capture and replay of FTP32 sessions, for profiling real-world traces without a server.
+//
+// Record:
+//   WiFiClient c, d;
+//   FTP32Recorder rec(file);
+//   FTP32RecordingClient rc(c, rec, 'C'), rd(d, rec, 'D');
+//   FTP32 ftp(rc, rd, "192.168.1.10");
+//   ... any operations ...
+//   rec.flush();
+//
+// Replay:
+//   FTP32Replay replay(file, FTP32Replay::FULL_SPEED);
+//   FTP32 ftp(replay.control(), replay.data());
+//   ... the same operations ...
+//
+// Trace is a sequence of records, each one is a "<channel><event> <time_us> <length>\n" header
+// followed by <length> payload bytes. Events:
+//  - '<' bytes read by FTP32
+//  - '>' bytes written by FTP32 (ignored on replay)
+//  - '+' connected, 'x' connection failed
+//  - '!' peer closed the connection (first time connected() returned false)
+//  - '-' stop() called on an open connection (repeated stops, e.g. from destructors, aren't recorded)
+// Records follow the order FTP32 consumed the data in, so replay takes the same code path.
+// Reads are split into separate records where the data wasn't there yet (available() returned 0)
+// or arrived more than FTP32_REPLAY_GAP_US apart, so fragmented and delayed replies keep their timing.
+// TLS sessions can't be replayed (recording happens below TLS).
+
+#include <Client.h>
+#include <esp_timer.h>
+
+#define FTP32_REPLAY_CHUNK 256 ///< max payload of a single record
+#define FTP32_REPLAY_GAP_US 1000 ///< consecutive reads further apart than this go to separate records
+
+/** @brief writes trace records, consecutive reads|writes of the same channel are merged into one record
+  * unless there was a gap between them @see gap()
+  **/
+class FTP32Recorder{
+public:
+  /** @param[in] sink trace destination, e.g. a file; slow sinks affect the recorded timing **/
+  FTP32Recorder(Print& sink) : _sink(sink){}
+
+  ~FTP32Recorder(){
+    flush();
+  }
+
+  /** @brief adds an event to the trace
+    * @param[in] channel 'C' for control, 'D' for data
+    * @param[in] event @see trace format above
+    * @param[in] data payload of '<' and '>' events
+    * @param[in] size payload size
+    **/
+  void record(char channel, char event, const uint8_t* data = nullptr, size_t size = 0){
+    if( !_start ) _start = esp_timer_get_time();
+
+    if( event != '<' && event != '>' ){
+      flush();
+      _emit(channel, event, esp_timer_get_time() - _start, nullptr, 0);
+      return;
+    }
+
+    int64_t now = esp_timer_get_time() - _start;
+    if( _len && now - _last > FTP32_REPLAY_GAP_US ) flush();
+    _last = now;
+    while( size ){
+      if( _len && (_channel != channel || _event != event || _len == FTP32_REPLAY_CHUNK) ) flush();
+      if( !_len ){
+        _channel = channel;
+        _event = event;
+        _time = now;
+      }
+      size_t n = min(size, (size_t)(FTP32_REPLAY_CHUNK - _len));
+      memcpy(_buff + _len, data, n);
+      _len += n;
+      data += n;
+      size -= n;
+    }
+  }
+
+  /** @brief ends the pending read record of the channel, the next data didn't arrive together with it **/
+  void gap(char channel){
+    if( _len && _channel == channel && _event == '<' ) flush();
+  }
+
+  /** @brief writes the pending record **/
+  void flush(){
+    if( !_len ) return;
+    _emit(_channel, _event, _time, _buff, _len);
+    _len = 0;
+  }
+
+private:
+  void _emit(char channel, char event, int64_t time, const uint8_t* data, size_t size){
+    _sink.printf("%c%c %lld %u\n", channel, event, (long long)time, (unsigned)size);
+    if( size ) _sink.write(data, size);
+  }
+
+private:
+  Print& _sink;
+  int64_t _start{};
+
+  // pending record
+  char _channel{};
+  char _event{};
+  int64_t _time{};
+  int64_t _last{}; ///< time of the last recorded bytes
+  uint8_t _buff[FTP32_REPLAY_CHUNK];
+  size_t _len{};
+};
+
+/** @brief passes everything to the wrapped client and records it **/
+class FTP32RecordingClient : public Client {
+public:
+  /** @param[in] client real transport
+    * @param[in] recorder trace writer, may be shared by both channels
+    * @param[in] channel 'C' for control, 'D' for data
+    **/
+  FTP32RecordingClient(Client& client, FTP32Recorder& recorder, char channel)
+    : _client(client), _rec(recorder), _channel(channel){}
+
+  int connect(IPAddress ip, uint16_t port){ return _connected(_client.connect(ip, port)); }
+  int connect(const char* host, uint16_t port){ return _connected(_client.connect(host, port)); }
+
+  size_t write(uint8_t c){ return write(&c, 1); }
+
+  size_t write(const uint8_t* buf, size_t size){
+    size_t written = _client.write(buf, size);
+    _rec.record(_channel, '>', buf, written);
+    return written;
+  }
+
+  int available(){
+    int avail = _client.available();
+    if( !avail ) _rec.gap(_channel);
+    return avail;
+  }
+
+  int read(){
+    int c = _client.read();
+    if( c >= 0 ){
+      uint8_t b = c;
+      _rec.record(_channel, '<', &b, 1);
+    }
+    return c;
+  }
+
+  int read(uint8_t* buf, size_t size){
+    int read = _client.read(buf, size);
+    if( read > 0 ) _rec.record(_channel, '<', buf, read);
+    return read;
+  }
+
+  int peek(){ return _client.peek(); }
+  void flush(){ _client.flush(); }
+
+  void stop(){
+    _client.stop();
+    if( !_open ) return;
+    _open = false;
+    _rec.record(_channel, '-');
+  }
+
+  uint8_t connected(){
+    uint8_t c = _client.connected();
+    if( _open && !c ){
+      _open = false;
+      _rec.record(_channel, '!');
+    }
+    return c;
+  }
+
+  operator bool(){ return connected(); }
+
+private:
+  int _connected(int res){
+    _open = res;
+    _rec.record(_channel, res ? '+' : 'x');
+    return res;
+  }
+
+private:
+  Client& _client;
+  FTP32Recorder& _rec;
+  char _channel;
+  bool _open{false};
+};
+
+class FTP32Replay;
+
+/** @brief one channel of a replayed session @see FTP32Replay **/
+class FTP32ReplayClient : public Client {
+public:
+  FTP32ReplayClient(FTP32Replay& replay, char channel) : _replay(replay), _channel(channel){}
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char* host, uint16_t port);
+  size_t write(uint8_t c){ return _open; }
+  size_t write(const uint8_t* buf, size_t size){ return _open ? size : 0; }
+  int available();
+  int read(){
+    if( !available() ) return -1;
+    return _buff[_pos++];
+  }
+  int read(uint8_t* buf, size_t size){
+    if( !available() ) return -1;
+    size_t n = min(size, _len - _pos);
+    memcpy(buf, _buff + _pos, n);
+    _pos += n;
+    return n;
+  }
+  int peek(){ return available() ? _buff[_pos] : -1; }
+  void flush(){}
+  void stop();
+  uint8_t connected();
+  operator bool(){ return connected(); }
+
+private:
+  friend class FTP32Replay;
+
+  FTP32Replay& _replay;
+  char _channel;
+  bool _open{false};
+
+  uint8_t _buff[FTP32_REPLAY_CHUNK];
+  size_t _pos{};
+  size_t _len{};
+};
+
+/** @brief feeds a recorded trace back into FTP32 through a pair of clients
+  *
+  * Data becomes available either as soon as FTP32 asks for it (FULL_SPEED)
+  * or not earlier than it was received originally (REAL_TIME), counting from the first connect().
+  * Trace is read sequentially, so it can be streamed from a file of any size.
+  **/
+class FTP32Replay{
+public:
+  enum Timing {FULL_SPEED, REAL_TIME};
+
+  FTP32Replay(Stream& trace, Timing timing = Timing::FULL_SPEED)
+    : _trace(trace), _timing(timing){}
+
+  FTP32ReplayClient& control(){ return _control; }
+  FTP32ReplayClient& data(){ return _data; }
+
+  /** @return whether the whole trace has been consumed (trailing writes don't count) **/
+  bool finished(){
+    return !_skipWrites();
+  }
+
+private:
+  friend class FTP32ReplayClient;
+
+  struct Head{
+    char channel;
+    char event;
+    int64_t time;
+    size_t size;
+  };
+
+  /** @brief parses the next record header if it isn't parsed yet
+    * @return false at the end of the trace
+    **/
+  bool _loadHead(){
+    if( _has_head ) return true;
+    char line[48];
+    size_t n = _trace.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = 0;
+    long long time;
+    unsigned size;
+    if( n < 2 || sscanf(line + 2, "%lld %u", &time, &size) != 2 || size > FTP32_REPLAY_CHUNK ) return false;
+    _head = Head{line[0], line[1], time, size};
+    _has_head = true;
+    return true;
+  }
+
+  /** @brief consumes the head record, payload goes to dest if given **/
+  void _pop(FTP32ReplayClient* dest){
+    if( dest ){
+      dest->_len = _trace.readBytes(dest->_buff, _head.size);
+      dest->_pos = 0;
+    } else {
+      for( size_t i = 0; i < _head.size; ++i ) _trace.read();
+    }
+    _has_head = false;
+  }
+
+  /** @brief skips what FTP32 sent, it's not checked
+    * @return false at the end of the trace
+    **/
+  bool _skipWrites(){
+    while( _loadHead() ){
+      if( _head.event != '>' ) return true;
+      _pop(nullptr);
+    }
+    return false;
+  }
+
+  FTP32ReplayClient& _client(char channel){
+    return channel == 'C' ? _control : _data;
+  }
+
+  int _connect(FTP32ReplayClient& c){
+    if( !_start ) _start = esp_timer_get_time();
+    if( !_skipWrites() || _head.channel != c._channel ) return 0;
+    if( _head.event != '+' && _head.event != 'x' ) return 0;
+    c._open = _head.event == '+';
+    c._pos = c._len = 0;
+    _pop(nullptr);
+    return c._open;
+  }
+
+  int _available(FTP32ReplayClient& c){
+    if( c._pos < c._len ) return c._len - c._pos;
+    if( !_skipWrites() || _head.channel != c._channel || _head.event != '<' ) return 0;
+    if( _timing == Timing::REAL_TIME && esp_timer_get_time() - _start < _head.time ) return 0;
+    _pop(&c);
+    return c._len;
+  }
+
+  void _stop(FTP32ReplayClient& c){
+    c._open = false;
+    c._pos = c._len = 0;
+    if( _skipWrites() && _head.channel == c._channel && _head.event == '-' ) _pop(nullptr);
+  }
+
+  uint8_t _connected(FTP32ReplayClient& c){
+    if( !c._open ) return 0;
+    if( c._pos < c._len ) return 1;
+    if( !_skipWrites() ){ c._open = false; return 0; } // nothing left to replay
+    if( _head.channel == c._channel && _head.event == '!' ){
+      if( _timing == Timing::REAL_TIME && esp_timer_get_time() - _start < _head.time ) return 1;
+      _pop(nullptr);
+      c._open = false;
+    }
+    return c._open;
+  }
+
+private:
+  Stream& _trace;
+  Timing _timing;
+  int64_t _start{};
+
+  Head _head{};
+  bool _has_head{false};
+
+  FTP32ReplayClient _control{*this, 'C'};
+  FTP32ReplayClient _data{*this, 'D'};
+};
+
+inline int FTP32ReplayClient::connect(IPAddress ip, uint16_t port){ return _replay._connect(*this); }
+inline int FTP32ReplayClient::connect(const char* host, uint16_t port){ return _replay._connect(*this); }
+inline int FTP32ReplayClient::available(){ return _replay._available(*this); }
+inline void FTP32ReplayClient::stop(){ _replay._stop(*this); }
+inline uint8_t FTP32ReplayClient::connected(){ return _replay._connected(*this); }
+
+#endif // FTP32_REPLAY_H